@@ -0,0 +1,186 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Times the processing of frames for every analysis length. What is timed depends on the mode:
+//  frames: one whole frame, calcSpectrum and calcAverage. Each length runs on a pool without threads, which does a
+//          whole frame on one thread, and on a pool with threads, which splits the frame up like the workers do.
+//          The fft stage alone is timed for both FftModes as well, on the pool without threads.
+//  stages: the spectral stage, calcFft, and the neighbour bin coherence stage, calcSpectralProducts, on both pools.
+//  copy:   copying the StateData of a frame, the way the ui takes a snapshot of it.
+// laabench runs in the precision of laatool. A double build also makes laabench_float, to compare the precisions.
+//
+// usage: laabench [frames|stages|copy] [max length] [frame pool threads] [seconds per measurement]
+
+#include "../src/state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+namespace {
+/// keeps the compiler from dropping the snapshot copies
+volatile Real copySink = 0;
+
+/**
+ * \brief Run func until seconds passed, at least a few times. It runs once more before, untimed
+ * \param func what to time
+ * \param seconds minimum time to measure
+ * \return mean time per run, in microseconds
+ */
+template <class Func>
+double timeRuns(Func&& func, double seconds) noexcept
+{
+    using Clock = std::chrono::steady_clock;
+    // the first run looks up windows, plans and smoothings, and touches all the memory
+    func();
+
+    size_t runs = 0;
+    auto start = Clock::now();
+    double elapsed = 0.0;
+    while (runs < 3 || elapsed < seconds) {
+        func();
+        ++runs;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return elapsed * 1e6 / static_cast<double>(runs);
+}
+
+/**
+ * \brief Make a state and fill it with a frame. Reference is noise, input a smeared copy of it, so the transfer function is not trivial
+ * \param length fft length
+ * \param generator noise source
+ * \return the state
+ */
+std::shared_ptr<State> makeState(size_t length, std::mt19937& generator) noexcept
+{
+    std::normal_distribution<double> noise;
+    auto state = std::make_shared<State>(length);
+    auto& data = state->accessData();
+    double last = 0.0;
+    for (size_t i = 0; i < length; i++) {
+        auto sample = noise(generator);
+        data.reference[i] = static_cast<Real>(sample);
+        last = 0.7 * last + 0.3 * sample;
+        data.input[i] = static_cast<Real>(last);
+    }
+    state->setSettings(StateFilterSettings());
+    return state;
+}
+
+/// whole frames on both pools, and the fft stage in both FftModes
+void benchFrames(State& state, TaskPool& serialPool, TaskPool& splitPool, double seconds) noexcept
+{
+    StateFilterConfig filterConfig;
+    auto frame = [&](TaskPool& pool) {
+        return [&]() {
+            state.calcSpectrum(pool);
+            state.calcAverage(filterConfig, pool);
+        };
+    };
+    double serial = timeRuns(frame(serialPool), seconds);
+    double split = timeRuns(frame(splitPool), seconds);
+
+    double separate = timeRuns([&]() { state.calcFft(serialPool); }, seconds);
+    StateFilterSettings packedSettings;
+    packedSettings.fftMode = FftMode::PackedComplex;
+    state.setSettings(packedSettings);
+    double packed = timeRuns([&]() { state.calcFft(serialPool); }, seconds);
+    std::printf("%14.1f %14.1f %8.2f %14.1f %14.1f %8.2f\n", serial, split, serial / split, separate, packed, separate / packed);
+}
+
+/// the spectral and the coherence stage on both pools
+void benchStages(State& state, TaskPool& serialPool, TaskPool& splitPool, double seconds) noexcept
+{
+    double fftSerial = timeRuns([&]() { state.calcFft(serialPool); }, seconds);
+    double fftSplit = timeRuns([&]() { state.calcFft(splitPool); }, seconds);
+    // only reads the spectra, so it can run over and over on the same ones
+    double coherenceSerial = timeRuns([&]() { state.calcSpectralProducts(serialPool); }, seconds);
+    double coherenceSplit = timeRuns([&]() { state.calcSpectralProducts(splitPool); }, seconds);
+    std::printf("%14.1f %14.1f %14.1f %14.1f\n", fftSerial, fftSplit, coherenceSerial, coherenceSplit);
+}
+
+/// a snapshot copy of the frame
+void benchCopy(State& state, double seconds) noexcept
+{
+    const auto& data = state.getData();
+    double copy = timeRuns(
+        [&]() {
+            StateData snapshot(data);
+            // something of the copy has to be used, or it might not happen at all
+            copySink = snapshot.input[snapshot.fftLen / 2];
+        },
+        seconds);
+
+    // signals and irs are fftLen long, spectra binCount. Both ffts, transfer functions and csd are complex
+    size_t realCount = 6 * data.fftLen + 6 * data.binCount + 2 * 5 * data.binCount;
+    double megabytes = static_cast<double>(realCount * sizeof(Real)) / (1024.0 * 1024.0);
+    std::printf("%14.1f %14.1f %14.2f\n", copy, megabytes, megabytes / 1024.0 / (copy * 1e-6));
+}
+}
+
+int main(int argc, char** argv)
+{
+    int arg = 1;
+    std::string mode = "frames";
+    if (argc > arg && (std::strcmp(argv[arg], "frames") == 0 || std::strcmp(argv[arg], "stages") == 0 || std::strcmp(argv[arg], "copy") == 0)) {
+        mode = argv[arg++]; // NOLINT
+    }
+    size_t maxLength = argc > arg ? std::stoul(argv[arg]) : LAA_MAX_FFT_LENGTH; // NOLINT
+    ++arg;
+    auto defaultThreads = std::clamp(static_cast<size_t>(std::thread::hardware_concurrency()) / 2, static_cast<size_t>(1), static_cast<size_t>(8));
+    size_t threads = argc > arg ? std::stoul(argv[arg]) : defaultThreads; // NOLINT
+    ++arg;
+    double seconds = argc > arg ? std::stod(argv[arg]) : 1.0; // NOLINT
+
+    // same as the app
+    FftPlan::initThreads(defaultThreads);
+    TaskPool serialPool;
+    TaskPool splitPool;
+    splitPool.start(threads);
+
+    std::printf("%s, precision %s, kernels %s, frame pool threads %zu\n", mode.c_str(), std::is_same_v<Real, float> ? "float" : "double", kernels().name, threads);
+    if (mode == "frames") {
+        std::printf("%10s %14s %14s %8s %14s %14s %8s\n", "length", "serial [us]", "split [us]", "speedup", "separate [us]", "packed [us]", "speedup");
+    } else if (mode == "stages") {
+        std::printf("%10s %14s %14s %14s %14s\n", "length", "fft [us]", "fft split", "coherence [us]", "coh. split");
+    } else {
+        std::printf("%10s %14s %14s %14s\n", "length", "copy [us]", "size [MB]", "[GB/s]");
+    }
+
+    std::mt19937 generator(1);
+    for (size_t length = LAA_MIN_FFT_LENGTH; length <= std::min(maxLength, LAA_MAX_FFT_LENGTH); length *= 2) {
+        auto state = makeState(length, generator);
+        std::printf("%10zu ", length);
+        if (mode == "frames") {
+            benchFrames(*state, serialPool, splitPool, seconds);
+        } else if (mode == "stages") {
+            state->calcFft(serialPool);
+            benchStages(*state, serialPool, splitPool, seconds);
+        } else {
+            state->calcSpectrum(serialPool);
+            benchCopy(*state, seconds);
+        }
+        std::fflush(stdout);
+    }
+
+    return 0;
+}
@@ -17,10 +17,12 @@
 
 #include "audioconfig.h"
 
+#include <cmath>
+
 std::vector<size_t> AudioConfig::getPossibleAnalysisSampleRates() noexcept
 {
     std::vector<size_t> rates;
-    for (size_t i = LAA_MIN_FFT_LENGTH; i < LAA_MAX_FFT_LENGTH; i <<= 1u) {
+    for (size_t i = LAA_MIN_FFT_LENGTH; i <= LAA_MAX_FFT_LENGTH; i <<= 1u) {
         rates.push_back(i);
     }
 
@@ -39,6 +41,24 @@ std::string AudioConfig::sampleCountToString(size_t count) const noexcept
     result = std::to_string(count) + " (" + std::to_string(seconds) + "s / " + std::to_string(1.0 / seconds) + "Hz)";
     return result;
 }
+
+size_t AudioConfig::getAnalysisHop() const noexcept
+{
+    return std::clamp(analysisHop, std::min(minAnalysisHop, analysisSamples), analysisSamples);
+}
+
+void AudioConfig::setAnalysisOverlap(double overlap) noexcept
+{
+    overlap = std::clamp(overlap, 0.0, 1.0);
+    analysisHop = static_cast<size_t>(std::round(static_cast<double>(analysisSamples) * (1.0 - overlap)));
+    analysisHop = getAnalysisHop();
+}
+
+double AudioConfig::getAnalysisOverlap() const noexcept
+{
+    return 1.0 - static_cast<double>(getAnalysisHop()) / static_cast<double>(analysisSamples);
+}
+
 std::vector<unsigned int> AudioConfig::getLegalSampleRates() noexcept
 {
     std::vector<unsigned int> result;
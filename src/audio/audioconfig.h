@@ -31,6 +31,8 @@ struct AudioConfig {
     static constexpr unsigned int defaultSampleRate = 48000;
     /// Default Analysis Sample Count
     static constexpr size_t defaultAnalysisSamples = 32768;
+    /// Smallest hop between two analysis frames we allow
+    static constexpr size_t minAnalysisHop = 64;
     /// Default size of the Buffer for the callbacks
     static constexpr int defaultBufferFrames = 512;
 
@@ -43,6 +45,8 @@ struct AudioConfig {
     unsigned int sampleRate = defaultSampleRate;
     /// Analysis Sampe Count
     size_t analysisSamples = defaultAnalysisSamples;
+    /// Samples between the start of two analysis frames. analysisSamples means no overlap. A sweep always gets one frame per sweep
+    size_t analysisHop = defaultAnalysisSamples;
     /// Output Volume
     double outputVolume = 1.0;
 
@@ -75,6 +79,24 @@ struct AudioConfig {
      */
     [[nodiscard]] std::string sampleCountToString(size_t count) const noexcept;
 
+    /**
+     * \brief The hop between two analysis frames, clamped to something sensible for the current analysis length
+     * \return hop in samples
+     */
+    [[nodiscard]] size_t getAnalysisHop() const noexcept;
+
+    /**
+     * \brief Set the hop between two frames via the overlap of two consecutive frames
+     * \param overlap overlap in 0..1. 0.75 means a new frame every quarter of analysisSamples
+     */
+    void setAnalysisOverlap(double overlap) noexcept;
+
+    /**
+     * \brief Overlap of two consecutive frames, as set by the hop
+     * \return overlap in 0..1
+     */
+    [[nodiscard]] double getAnalysisOverlap() const noexcept;
+
     /**
      * \brief Return Sample rates supported by both the input and the output device
      * \return A vector containing the sample rates
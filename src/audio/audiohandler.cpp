@@ -20,13 +20,6 @@
 #include <filesystem> // exsists
 namespace fs = std::filesystem;
 
-template <class T>
-void clearStateQueue(std::queue<T>& q)
-{
-    std::queue<T> empty;
-    std::swap(q, empty);
-}
-
 AudioHandler::AudioHandler() noexcept
 {
     rtAudio = std::make_unique<RtAudio>();
@@ -50,36 +43,30 @@ AudioHandler::AudioHandler() noexcept
     // essentially it saves what it knows about the most performant way to calc to the drive
     // we ask sdl for the path. i didnt ad that function to sdl2wrap yet, so yeah
     auto* pWisdomPath = SDL_GetPrefPath("mkalte", "laa");
-    std::string wisdomPath = pWisdomPath;
+    wisdomPath = pWisdomPath;
     SDL_free(pWisdomPath); // yep
 
-    wisdomPath += "/fftwWisdom" + getVersionString() + ".fftw";
+    // double and float wisdom are kept apart
+    wisdomPath += "/fftwWisdom" + getVersionString() + (std::is_same_v<Real, float> ? "f" : "") + ".fftw";
+    // long ffts get a few threads of their own. threads must be on before wisdom is loaded
+    FftPlan::initThreads(std::clamp(static_cast<size_t>(std::thread::hardware_concurrency()) / 2, static_cast<size_t>(1), static_cast<size_t>(8)));
+
+    // pick and check the spectral kernels now, not on the first frame
+    kernels();
+
     // we can only import wisdom if we exsist
     if (fs::exists(wisdomPath)) {
-        fftw_import_wisdom_from_filename(wisdomPath.c_str());
+        FftPlan::loadWisdom(wisdomPath);
     }
 
-    // populate state pool
-    // due to the nature for fftw, this might take a while...
-    // state creation creates the fftw things!
-    for (auto rate : AudioConfig::getPossibleAnalysisSampleRates()) {
-        StatePoolArray pool;
-        for (auto& state : pool) {
-            state = std::make_shared<State>(rate);
-        }
-        statePool[rate] = pool;
-    }
-
-    // save wisdom. see above
-    fftw_export_wisdom_to_filename(wisdomPath.c_str());
-
     // reset everything
+    // this also starts building the state pool for the default length, and publishes the first settings. the wisdom is saved once that is done
     resetStates();
 
-    // spin up data processing thread
-    dataProcessor = std::thread([this]() {
-        this->processingWorker();
-    });
+    // spin up data processing threads
+    // leave some room for the ui and the audio callback
+    workerCount = std::clamp(static_cast<size_t>(std::thread::hardware_concurrency()) / 2, static_cast<size_t>(1), static_cast<size_t>(4));
+    startWorkers(workerCount);
 
     // and done!
 }
@@ -91,9 +78,11 @@ AudioHandler::~AudioHandler() noexcept
         rtAudio.reset();
     }
 
-    // destroy thread
-    terminateThreads = true;
-    dataProcessor.join();
+    // destroy threads. a restart might still be stopping them
+    if (workerStop.valid()) {
+        workerStop.wait();
+    }
+    stopWorkers();
 
     // clean up states
     statePool.clear();
@@ -106,8 +95,12 @@ void AudioHandler::startAudio()
     sweepGenerator.setSampleRate(config.sampleRate);
     sweepGenerator.setLength(static_cast<double>(config.analysisSamples) / config.sampleRate);
 
-    // assure we are not running anymore
+    // assure we are not running anymore, and the states know about the new sample rate
     stopAudio();
+    resetStates();
+
+    // the callback publishes its thread on its first call, checkAudioThread pins it
+    audioThreadPublished = false;
 
     // opens the streams. this throws if there is an error. let it crash for now.
     rtAudio->openStream(&config.playbackParams, &config.captureParams, RTAUDIO_FLOAT32, config.sampleRate, &config.bufferFrames, &rtAudioCallback, this);
@@ -126,29 +119,282 @@ void AudioHandler::stopAudio()
         rtAudio->closeStream();
     }
 
+    // the callback thread might be gone now, it must not be pinned anymore
+    audioThread = 0;
+    pinnedAudioThread = 0;
+    audioCpu = -1;
     running = false;
 }
 
 void AudioHandler::resetStates() noexcept
 {
-    // halt the audio world
-    processingLock.lock();
-    callbackLock.lock();
+    // halt the audio world. the worker only touches the rings while holding processingLock,
+    // and the callback lets go of everything once it acknowledged the pause.
+    std::lock_guard<std::mutex> lock(processingLock);
+    pauseCapture();
+
+    // the callback picks up the frame settings from here
+    captureLength = config.analysisSamples;
+    captureHop = config.getAnalysisHop();
+    captureSampleRate = static_cast<double>(config.sampleRate);
+    // the averaging history is sized for the length
+    publishSettings();
 
     // clear them all
+    // whatever the worker is currently chewing on belongs to the old generation and is dropped once done
+    ++poolGeneration;
+    nextSequence = 0;
+    nextPublish = 0;
+    finishedFrames.clear();
+    publishing = false;
     doneState = nullptr;
-    captureState = nullptr;
-    clearStateQueue(unusedStates);
-    clearStateQueue(processStates);
+    std::atomic_store(&publishedData, StateDataPtr());
+    retiredStates.clear();
+    State* state = nullptr;
+    while (processStates.pop(state)) {
+    }
+    while (unusedStates.pop(state)) {
+    }
+
+    // the capture rings only need to hold one frame. The callback does not touch them while paused
+    if (inputRing.size() != captureLength) {
+        inputRing = RealVec(captureLength, 0.0);
+        referenceRing = RealVec(captureLength, 0.0);
+    }
+
+    // only the pool of the active length is kept. states of the others go away once no worker or view holds them anymore
+    for (auto iter = statePool.begin(); iter != statePool.end();) {
+        iter = iter->first == config.analysisSamples ? std::next(iter) : statePool.erase(iter);
+    }
+
+    // there might not be a pool for this length yet. capture stays paused until it is built, \sa checkPoolBuild
+    auto activePool = statePool.find(config.analysisSamples);
+    if (activePool == statePool.end()) {
+        startPoolBuild(config.analysisSamples);
+        updatePoolStats();
+        return;
+    }
 
     // fill in the proper ones
-    for (auto& state : statePool[config.analysisSamples]) {
-        unusedStates.push(state);
+    // states still held by a worker or the ui have to wait until they are let go of
+    for (auto& poolState : activePool->second) {
+        if (poolState.use_count() == 1) {
+            unusedStates.push(poolState.get());
+        } else {
+            retiredStates.push_back(poolState);
+        }
     }
+    updatePoolStats();
 
     // can run again
-    callbackLock.unlock();
-    processingLock.unlock();
+    resumeCapture();
+}
+
+AudioHandler::StatePoolArray AudioHandler::makePool(size_t length) noexcept
+{
+    StatePoolArray pool;
+    size_t count = length > longPoolLength ? longPoolSize : defaultPoolSize;
+    for (size_t i = 0; i < count; i++) {
+        pool.push_back(std::make_shared<State>(length));
+    }
+    return pool;
+}
+
+void AudioHandler::startPoolBuild(size_t length) noexcept
+{
+    // a build that is already running cannot be stopped. checkPoolBuild throws it away if it is for another length.
+    if (poolBuild.valid()) {
+        return;
+    }
+
+    // the first pool of a length plans its ffts, which can take seconds. wisdom is saved right after, while we are still off the ui thread.
+    poolBuildLength = length;
+    poolBuild = std::async(std::launch::async, [length, path = wisdomPath]() {
+        auto pool = makePool(length);
+        FftPlan::saveWisdom(path);
+        return pool;
+    });
+}
+
+void AudioHandler::checkPoolBuild() noexcept
+{
+    // states retired by a reset usually come back with the next publish. If every state was retired,
+    // capture starves and nothing is published anymore, so we check here as well.
+    {
+        std::lock_guard<std::mutex> lock(processingLock);
+        recycleStates();
+    }
+
+    using namespace std::chrono_literals;
+    if (!poolBuild.valid() || poolBuild.wait_for(0s) != std::future_status::ready) {
+        return;
+    }
+
+    auto pool = poolBuild.get();
+    if (poolBuildLength == config.analysisSamples) {
+        std::lock_guard<std::mutex> lock(processingLock);
+        statePool[poolBuildLength] = std::move(pool);
+    }
+    poolBuildLength = 0;
+
+    // hands the new pool to the capture. if the length changed in the meantime, this starts another build
+    resetStates();
+}
+
+void AudioHandler::pauseCapture() noexcept
+{
+    // needed for sleep
+    using namespace std::chrono;
+
+    auto request = captureRequest.fetch_add(1) + 1;
+
+    // no stream means no callback, so we can clean up after it ourselves
+    if (!running) {
+        ringWrite = 0;
+        ringFill = 0;
+        hopCount = 0;
+        sweepCount = 0;
+        captureAck.store(request);
+        return;
+    }
+
+    // the callback runs every bufferFrames samples, so this does not take long
+    while (captureAck.load(std::memory_order_acquire) != request) {
+        std::this_thread::sleep_for(1ms);
+    }
+}
+
+void AudioHandler::resumeCapture() noexcept
+{
+    captureResume.store(captureRequest.load(), std::memory_order_release);
+}
+
+void AudioHandler::startWorkers(size_t count) noexcept
+{
+    // the frame pool only ever works for the processing workers, so it lives and dies with them
+    // they get the same priority as the workers, but do not follow the audio callback around
+    framePool.start(frameThreadCount, [scheduling = workerScheduling]() {
+        applyThreadPriority(scheduling);
+        applyThreadAffinity(scheduling, -1);
+    });
+
+    terminateThreads = false;
+    {
+        std::lock_guard<std::mutex> lock(schedulingLock);
+        schedulingStatus.clear();
+    }
+
+    // the pipeline always has one thread per stage
+    if (processingMode == ProcessingMode::Pipeline) {
+        fftQueue.reopen();
+        spectralQueue.reopen();
+        dataProcessors.emplace_back([this, scheduling = workerScheduling]() {
+            this->fftStage(scheduling);
+        });
+        dataProcessors.emplace_back([this, scheduling = workerScheduling]() {
+            this->spectralStage(scheduling);
+        });
+        dataProcessors.emplace_back([this, scheduling = workerScheduling]() {
+            this->smoothingStage(scheduling);
+        });
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        dataProcessors.emplace_back([this, scheduling = workerScheduling]() {
+            this->processingWorker(scheduling);
+        });
+    }
+}
+
+void AudioHandler::stopWorkers() noexcept
+{
+    terminateThreads = true;
+    for (size_t i = 0; i < dataProcessors.size(); i++) {
+        workerWakeup.post();
+    }
+    for (auto& worker : dataProcessors) {
+        worker.join();
+    }
+    dataProcessors.clear();
+    framePool.stop();
+}
+
+void AudioHandler::restartWorkers() noexcept
+{
+    // a worker only notices terminateThreads once its frame is done, which can take a while for long frames.
+    // joining them here would freeze the ui, so that happens on another thread. a restart that is already underway picks up the new settings as well.
+    if (workerStop.valid()) {
+        return;
+    }
+
+    workerStop = std::async(std::launch::async, [this]() {
+        stopWorkers();
+    });
+}
+
+void AudioHandler::checkWorkerRestart() noexcept
+{
+    using namespace std::chrono_literals;
+    if (!workerStop.valid() || workerStop.wait_for(0s) != std::future_status::ready) {
+        return;
+    }
+
+    workerStop.get();
+    startWorkers(workerCount);
+}
+
+void AudioHandler::checkAudioThread() noexcept
+{
+    auto thread = audioThread.load(std::memory_order_acquire);
+    if (thread == 0 || thread == pinnedAudioThread) {
+        return;
+    }
+
+    pinnedAudioThread = thread;
+    pinThread(thread, audioCpuPin.load(std::memory_order_relaxed));
+    audioCpu.store(pinnedCpu(thread), std::memory_order_relaxed);
+}
+
+void AudioHandler::publishSettings() noexcept
+{
+    // the frame history is allocated here, so the worker that publishes frames never has to
+    size_t binCount = captureLength / 2 + 1;
+    size_t historyFrames = StateFilterConfig::historyFrames(filterSettings.avgCount, binCount);
+    if (filterSettings.avgMode != SpectrumAveraging::Frames || historyFrames == 0) {
+        filterSettings.avgHistory = nullptr;
+    } else if (filterSettings.avgHistory == nullptr || filterSettings.avgHistory->binCount != binCount
+        || filterSettings.avgHistory->frameCount != historyFrames) {
+        filterSettings.avgHistory = std::make_shared<SpectrumHistory>(binCount, historyFrames);
+    }
+
+    // every version is a new object, so a worker never sees one that is half written
+    ++filterSettings.version;
+    settingsVersions.push_back(std::make_unique<const StateFilterSettings>(filterSettings));
+    currentSettings.store(settingsVersions.back().get(), std::memory_order_release);
+
+    // versions the workers moved past can go
+    auto acked = settingsAck.load(std::memory_order_acquire);
+    settingsVersions.erase(std::remove_if(settingsVersions.begin(), settingsVersions.end() - 1, [acked](const auto& settings) {
+        return settings->version < acked;
+    }),
+        settingsVersions.end() - 1);
+}
+
+void AudioHandler::updatePoolStats() noexcept
+{
+    // no pool yet while it is being built
+    size_t memory = 0;
+    size_t count = 0;
+    auto pool = statePool.find(captureLength);
+    if (pool != statePool.end()) {
+        for (const auto& state : pool->second) {
+            memory += state->memoryUsage();
+        }
+        count = pool->second.size();
+    }
+    poolStateCount = count;
+    poolMemory = memory;
 }
 
 size_t AudioHandler::getFrameCount() const noexcept
@@ -22,10 +22,15 @@
 #include "../dsp/sinegenerator.h"
 #include "../dsp/sweepgenerator.h"
 #include "audioconfig.h"
+#include "boundedqueue.h"
+#include "lightweightsemaphore.h"
+#include "spscring.h"
+#include "threadscheduling.h"
 
+#include <atomic>
+#include <future>
 #include <map>
 #include <mutex>
-#include <queue>
 #include <thread>
 
 /**
@@ -46,6 +51,42 @@ enum class FunctionGeneratorType {
  */
 std::string getStr(const FunctionGeneratorType& gen) noexcept;
 
+/**
+ * \brief What to do with frames when the state pool runs dry
+ */
+enum class PoolPolicy {
+    /// the frame that does not get a state is lost
+    DropNewest,
+    /// pending frames are skipped in favour of the newest one, so the pool refills quickly
+    OverwriteOldest,
+    /// the pool grows, up to a memory cap, whenever it ran dry
+    Grow
+};
+
+/**
+ * \brief Convert the PoolPolicy enum to a string
+ * \param policy PoolPolicy to stringify
+ * \return policy as a string
+ */
+std::string getStr(const PoolPolicy& policy) noexcept;
+
+/**
+ * \brief How frames are spread over the processing threads
+ */
+enum class ProcessingMode {
+    /// every worker takes a whole frame through all stages
+    WorkerPool,
+    /// one thread per stage, frames are handed from stage to stage
+    Pipeline
+};
+
+/**
+ * \brief Convert the ProcessingMode enum to a string
+ * \param mode ProcessingMode to stringify
+ * \return mode as a string
+ */
+std::string getStr(const ProcessingMode& mode) noexcept;
+
 /**
  * \brief Handles audio and audio UI config
  */
@@ -77,10 +118,11 @@ public:
     size_t getFrameCount() const noexcept;
 
     /**
-     * \brief Get a copy of the data of the current state
-     * \return StateData of the current state
+     * \brief Get the data of the current state
+     * \note This does not copy. The state is only recycled once every reference to its data is gone.
+     * \return StateData of the current state, or nullptr if there is none yet
      */
-    StateData getStateData() const noexcept;
+    StateDataPtr getStateData() const noexcept;
 
     /**
      * \brief Return a const ref to the current configuration
@@ -91,6 +133,7 @@ public:
 private:
     /**
      * \brief Generates the next playback sample for output
+     * \note Runs on the audio thread. Must not allocate or lock.
      * \return
      */
     double genNextPlaybackSample();
@@ -105,11 +148,18 @@ private:
     void stopAudio();
     /**
      * \brief The member portion of the audio capture callback
+     * \note Must not allocate or lock. Debug builds check this, \sa RealtimeScope
      * \param stream
      * \param len
      */
     void audioCallback(void* out, void* in, size_t len);
 
+    /**
+     * \brief Copy the last captureLength samples of the capture rings into state
+     * \param state state to fill
+     */
+    void cutFrame(State& state) noexcept;
+
     /**
      * \brief The static callback called by rtaudio internals
      * \param outputBuffer
@@ -125,6 +175,17 @@ private:
      */
     void resetStates() noexcept;
 
+    /**
+     * \brief Ask the audio callback to stop capturing and wait until it let go of its capture rings
+     * \note Only call this from the ui thread
+     */
+    void pauseCapture() noexcept;
+
+    /**
+     * \brief Let the audio callback capture again after \sa pauseCapture
+     */
+    void resumeCapture() noexcept;
+
     /// current audio config
     AudioConfig config = {};
     /// rt audio instance
@@ -134,6 +195,8 @@ private:
     /// true if audio is running, false if not
     bool running = false;
 
+    /// generates white noise
+    WhiteNoiseGenerator whiteNoise = {};
     /// generates pink noise
     PinkNoiseGenerator pinkNoise = {};
     /// generates a sine
@@ -143,39 +206,265 @@ private:
     /// switches between audio generators.
     FunctionGeneratorType functionGeneratorType = FunctionGeneratorType::Silence;
 
-    /// thread worker for audio processing
-    void processingWorker() noexcept;
-    /// std::threa for the processingWorker
-    std::thread dataProcessor = {};
-    /// helps killing off the processing thread
-    bool terminateThreads = false;
-    /// protects the audio queue
-    mutable std::mutex callbackLock = {};
-    /// protects the processing queue
+    /**
+     * \brief thread worker for audio processing
+     * \param scheduling scheduling the worker applies to itself
+     */
+    void processingWorker(ThreadSchedulingConfig scheduling) noexcept;
+    /**
+     * \brief Pipeline stage: takes frames from the capture and runs the ffts
+     * \param scheduling scheduling the stage applies to itself
+     */
+    void fftStage(ThreadSchedulingConfig scheduling) noexcept;
+    /**
+     * \brief Pipeline stage: coherence and ir
+     * \param scheduling scheduling the stage applies to itself
+     */
+    void spectralStage(ThreadSchedulingConfig scheduling) noexcept;
+    /**
+     * \brief Pipeline stage: smoothing, averaging and publishing
+     * \param scheduling scheduling the stage applies to itself
+     */
+    void smoothingStage(ThreadSchedulingConfig scheduling) noexcept;
+    /**
+     * \brief A frame on its way through processing
+     */
+    struct Frame {
+        /// the state holding the frame
+        std::shared_ptr<State> state = nullptr;
+        /// sequence number the state got when it was taken out of processStates
+        size_t sequence = 0;
+        /// pool generation at the time the state was taken out of processStates
+        size_t generation = 0;
+    };
+    /**
+     * \brief Take the next frame out of processStates
+     * \note Only for the threads that consume processStates
+     * \param frame receives the frame
+     * \return false if there was nothing to take
+     */
+    bool takeFrame(Frame& frame) noexcept;
+    /**
+     * \brief Apply the worker scheduling to the calling thread
+     * Call this once with avoidedCpu = -2, and then every now and then to follow the audio callback around
+     * \param scheduling scheduling to apply
+     * \param priorityError receives what went wrong with the priority on the first call
+     * \param avoidedCpu cpu the thread is currently kept away from
+     */
+    void applyWorkerScheduling(const ThreadSchedulingConfig& scheduling, std::string& priorityError, int& avoidedCpu) noexcept;
+    /**
+     * \brief Hand a state that is done with calcSpectrum over for averaging and publishing
+     * Frames can finish out of order if there are several workers. This puts them back in order.
+     * \param state The state
+     * \param sequence sequence number the state got when it was taken out of processStates
+     * \param generation pool generation at the time the state was taken out of processStates
+     */
+    void finishFrame(const std::shared_ptr<State>& state, size_t sequence, size_t generation) noexcept;
+    /**
+     * \brief Give retired states nobody looks at anymore back to the capture
+     * \note processingLock must be held
+     */
+    void recycleStates() noexcept;
+    /**
+     * \brief Spin up count processing workers
+     * \param count number of workers
+     */
+    void startWorkers(size_t count) noexcept;
+    /**
+     * \brief Stop all processing workers. Frames they are working on are finished first.
+     */
+    void stopWorkers() noexcept;
+    /**
+     * \brief Stop the processing workers on another thread. checkWorkerRestart starts them again once they are gone
+     * \note Only call this from the ui thread. The workers start with the processing mode, counts and scheduling set by then
+     */
+    void restartWorkers() noexcept;
+    /**
+     * \brief Start the processing workers again once restartWorkers stopped them
+     * \note Only call this from the ui thread, once per ui frame
+     */
+    void checkWorkerRestart() noexcept;
+
+    /**
+     * \brief Pin the audio callback thread to audioCpuPin once it shows up, and find out which cpu it is on
+     * \note Runs on the ui thread, every update
+     */
+    void checkAudioThread() noexcept;
+    /// stopWorkers running on another thread, \sa restartWorkers
+    std::future<void> workerStop = {};
+    /**
+     * \brief Add another state to the active pool, if the memory cap allows it
+     * \note Called by the processing thread when PoolPolicy::Grow is active
+     */
+    void growPool() noexcept;
+    /**
+     * \brief Update poolStateCount and poolMemory for the active pool
+     * \note processingLock must be held
+     */
+    void updatePoolStats() noexcept;
+    /// std::threads for the processingWorker
+    std::vector<std::thread> dataProcessors = {};
+    /// number of processing workers to run
+    size_t workerCount = 1;
+    /// helps killing off the processing threads
+    std::atomic<bool> terminateThreads = { false };
+    /// posted by the callback whenever there is something for the workers to do
+    LightweightSemaphore workerWakeup = {};
+    /// protects the done state, the ordering of frames and the worker side of the state rings
     mutable std::mutex processingLock = {};
+    /// averaging needs the frames one after the other. This makes sure of that.
+    std::mutex averageLock = {};
+    /// how processing is spread over the threads. only read by startWorkers, so it can change while the workers restart
+    ProcessingMode processingMode = ProcessingMode::WorkerPool;
+    /// how many frames fit between two pipeline stages
+    static constexpr size_t pipelineQueueDepth = 4;
+    /// frames done with the ffts, waiting for spectralStage
+    BoundedQueue<Frame> fftQueue = BoundedQueue<Frame>(pipelineQueueDepth);
+    /// frames done with coherence and ir, waiting for smoothingStage
+    BoundedQueue<Frame> spectralQueue = BoundedQueue<Frame>(pipelineQueueDepth);
+    /// helps the processing workers with the parts of a frame that can run in parallel
+    TaskPool framePool = {};
+    /// number of threads in framePool. 0 does each frame on a single worker
+    size_t frameThreadCount = 0;
+    /// priority and cpus of the processing workers. Applied when they are started
+    ThreadSchedulingConfig workerScheduling = {};
+    /// cpu the audio callback pins itself to, or -1 to leave it alone. Applied when audio is started
+    std::atomic<int> audioCpuPin = { -1 };
+    /// set by the callback once it published audioThread
+    bool audioThreadPublished = false;
+    /// thread the audio callback runs on, 0 until its first call. The ui pins it, so the callback makes no syscalls
+    std::atomic<ThreadHandle> audioThread = { 0 };
+    /// the callback thread checkAudioThread already pinned. Only touched by the ui
+    ThreadHandle pinnedAudioThread = 0;
+    /// cpu the audio callback is pinned to, or -1 if it may move around
+    std::atomic<int> audioCpu = { -1 };
+    /// what went wrong when the workers applied workerScheduling. empty if nothing did
+    std::string schedulingStatus = "";
+    /// protects schedulingStatus
+    std::mutex schedulingLock = {};
 
     /// use shared pointers so we have less of a foot gun
     using StatePtr = std::shared_ptr<State>;
     /// pool of audio states (stateData + fluff around it)
-    using StatePoolArray = std::array<StatePtr, 5>;
+    using StatePoolArray = std::vector<StatePtr>;
+    /// number of states in a fresh pool
+    static constexpr size_t defaultPoolSize = 5;
+    /// pools for lengths above this start out with longPoolSize states
+    static constexpr size_t longPoolLength = 131072;
+    /// number of states in a fresh pool longer than longPoolLength. Each of those is hundreds of megabytes
+    static constexpr size_t longPoolSize = 3;
     /// map of states. map key is the analysis lengths
     std::map<size_t, StatePoolArray> statePool = {};
+    /**
+     * \brief Make a fresh pool
+     * \param length analysis length of the states
+     * \return the pool
+     */
+    static StatePoolArray makePool(size_t length) noexcept;
+    /**
+     * \brief Start building a pool for length on another thread
+     * \note Only call this from the ui thread
+     * \param length analysis length of the states
+     */
+    void startPoolBuild(size_t length) noexcept;
+    /**
+     * \brief Hand a finished pool build over to the capture, and retired states nobody looks at anymore
+     * \note Only call this from the ui thread, once per ui frame
+     */
+    void checkPoolBuild() noexcept;
+    /// pool being built by startPoolBuild
+    std::future<StatePoolArray> poolBuild = {};
+    /// analysis length poolBuild is for. 0 if there is no build
+    size_t poolBuildLength = 0;
+    /// where fftw wisdom is kept
+    std::string wisdomPath = "";
+    /// the rings only move raw pointers around. statePool keeps the states alive.
+    /// the capacity also limits how far a pool can grow
+    using StateRing = SpscRing<State*, 64>;
 
-    /// states current available for processing
-    std::queue<StatePtr> unusedStates = {};
+    /// states current available for processing. worker pushes, callback pops
+    StateRing unusedStates = {};
 
-    /// state that is current captured into
-    StatePtr captureState = nullptr;
-    /// number of samples already inside captureState
-    size_t sampleCount = 0;
-    /// states ready for processing
-    std::queue<StatePtr> processStates = {};
+    /// continuous capture of the input channel. Analysis frames are cut out of this. only touched by the callback,
+    /// and by resetStates to size it to captureLength
+    RealVec inputRing = {};
+    /// continuous capture of the reference channel. Same as inputRing
+    RealVec referenceRing = {};
+    /// next write position in the capture rings
+    size_t ringWrite = 0;
+    /// number of valid samples in the capture rings
+    size_t ringFill = 0;
+    /// samples captured since the last frame was cut out of the rings
+    size_t hopCount = 0;
+    /// samples captured since the sweep was last reset
+    size_t sweepCount = 0;
+    /// analysis length the callback cuts frames with. only changed while capture is paused
+    size_t captureLength = AudioConfig::defaultAnalysisSamples;
+    /// hop the callback cuts frames with. only changed while capture is paused, but the workers read it for their counters any time
+    std::atomic<size_t> captureHop = { AudioConfig::defaultAnalysisSamples };
+    /// states ready for processing. callback pushes, worker pops
+    StateRing processStates = {};
     /// the state that is done with processing and can be used
     StatePtr doneState = nullptr;
+    /// the data of doneState, as handed out to the ui. only use with std::atomic_load and std::atomic_store
+    StateDataPtr publishedData = nullptr;
+    /// states that were published, but might still be in use by the ui
+    std::vector<StatePtr> retiredStates = {};
     /// counts up every time a state is done with processing
-    size_t frameCount = 0;
+    std::atomic<size_t> frameCount = { 0 };
+    /// sample rate the frames are captured with. only changed while capture is paused
+    double captureSampleRate = AudioConfig::defaultSampleRate;
+    /// counts up on every reset, so the worker can drop frames from a pool that is gone
+    size_t poolGeneration = 0;
+    /// sequence number for the next frame taken out of processStates
+    size_t nextSequence = 0;
+    /// sequence number of the next frame to publish
+    size_t nextPublish = 0;
+    /// frames done with calcSpectrum that wait for their predecessors. key is the sequence number
+    std::map<size_t, StatePtr> finishedFrames = {};
+    /// true while some worker is working through finishedFrames
+    bool publishing = false;
+    /// poolStarvations as last seen by a worker
+    std::atomic<size_t> handledStarvations = { 0 };
 
-    /// configuration of the audio filter - shared between all states
+    /// what happens if the pool runs dry
+    std::atomic<PoolPolicy> poolPolicy = { PoolPolicy::DropNewest };
+    /// PoolPolicy::Grow does not let the active pool grow beyond this many bytes
+    std::atomic<size_t> poolMemoryCap = { static_cast<size_t>(512) * 1024 * 1024 };
+    /// number of states in the active pool
+    std::atomic<size_t> poolStateCount = { 0 };
+    /// bytes used by the active pool
+    std::atomic<size_t> poolMemory = { 0 };
+    /// frames that never made it to processing
+    std::atomic<size_t> droppedFrames = { 0 };
+    /// samples that were new in a dropped frame, i.e. no earlier frame covered them
+    std::atomic<size_t> droppedSamples = { 0 };
+    /// number of times the callback found the pool empty
+    std::atomic<size_t> poolStarvations = { 0 };
+    /// true while the callback keeps finding the pool empty. only touched by the callback
+    bool poolStarved = false;
+
+    /// bumped by the ui to ask the callback to pause capturing
+    std::atomic<size_t> captureRequest = { 0 };
+    /// set by the callback once it paused for captureRequest
+    std::atomic<size_t> captureAck = { 0 };
+    /// capture is running while this equals captureRequest
+    std::atomic<size_t> captureResume = { 0 };
+
+    /**
+     * \brief Hand filterSettings over to the workers as a new version
+     * \note Only call this from the ui thread
+     */
+    void publishSettings() noexcept;
+    /// the settings as edited by the ui. only touched by the ui thread
+    StateFilterSettings filterSettings = {};
+    /// published versions of filterSettings a worker might still look at. only touched by the ui thread
+    std::vector<std::unique_ptr<const StateFilterSettings>> settingsVersions = {};
+    /// newest version of the settings. Workers copy it into every frame they take
+    std::atomic<const StateFilterSettings*> currentSettings = { nullptr };
+    /// version the workers copied last. Versions older than this are not looked at anymore
+    std::atomic<size_t> settingsAck = { 0 };
+    /// averaging history - shared between all states. only touched under averageLock
     StateFilterConfig stateFilterConfig = {};
 };
 
@@ -16,6 +16,7 @@
  */
 
 #include "audiohandler.h"
+#include "realtimeguard.h"
 
 // just switches between audio sources for playback
 double AudioHandler::genNextPlaybackSample()
@@ -24,7 +25,7 @@ double AudioHandler::genNextPlaybackSample()
     case FunctionGeneratorType::Silence:
         break;
     case FunctionGeneratorType::WhiteNoise:
-        return (WhiteNoiseGenerator::nextSample());
+        return (whiteNoise.nextSample());
     case FunctionGeneratorType::PinkNoise:
         return (pinkNoise.nextSample());
     case FunctionGeneratorType::Sine:
@@ -40,6 +41,9 @@ double AudioHandler::genNextPlaybackSample()
 // playbackCallback and captureCallback are seperate but are both fed from here
 int AudioHandler::rtAudioCallback(void* outputBuffer, void* inputBuffer, unsigned int nFrames, double, RtAudioStreamStatus, void* userData)
 {
+    // anything that allocates or locks from here on is a bug
+    RealtimeScope realtime;
+
     // callback data is this, so NOLINTNEXTLINE
     auto* handler = reinterpret_cast<AudioHandler*>(userData);
     handler->audioCallback(outputBuffer, inputBuffer, nFrames * 2 * sizeof(float));
@@ -57,24 +61,37 @@ void AudioHandler::audioCallback(void* out, void* in, size_t len)
     // void pointers do that. NOLINTNEXTLINE
     auto* outPtr = reinterpret_cast<float*>(out);
 
-    // first check if there is no current capture State.
-    // We then try to get one from the unusedState queue.
-    // if there is none, we cant do things.
-    if (!captureState) {
-        callbackLock.lock();
-        if (unusedStates.empty()) {
-            callbackLock.unlock();
-            return;
-        }
+    // we never lock in here. The ui might want us to pause so it can reshuffle the states.
+    // if so, drop what we captured so far and tell it we did. Playback keeps going.
+    auto request = captureRequest.load(std::memory_order_acquire);
+    bool capturing = request == captureResume.load(std::memory_order_acquire);
+    if (!capturing && captureAck.load(std::memory_order_relaxed) != request) {
+        ringWrite = 0;
+        ringFill = 0;
+        hopCount = 0;
+        sweepCount = 0;
+        captureAck.store(request, std::memory_order_release);
+    }
 
-        sweepGenerator.reset(); // so they are somewhat in sync
-        captureState = unusedStates.front();
-        unusedStates.pop();
-        callbackLock.unlock();
+    // let the ui know which thread we are. It pins us and tells the workers where we are, so no syscall happens in here
+    if (!audioThreadPublished) {
+        audioThreadPublished = true;
+        audioThread.store(currentThreadHandle(), std::memory_order_release);
     }
 
     // then we loop over samples.
+    // the rings are only ours while capturing, resetStates resizes them during a pause
+    const size_t ringMask = capturing ? inputRing.size() - 1 : 0;
+    // a sweep restarts every captureLength samples. A frame only holds one whole sweep if it ends where one does,
+    // so while sweeping, frames are cut once per sweep and the hop is not used
+    const bool sweeping = functionGeneratorType == FunctionGeneratorType::Sweep;
+    const size_t hop = sweeping ? captureLength : captureHop.load(std::memory_order_relaxed);
     for (auto i = 0ULL; i + 1 < count; i += 2) {
+        // keep the sweep in sync with the analysis length
+        if (capturing && sweepCount == 0) {
+            sweepGenerator.reset();
+        }
+
         // output
         // next sample scaled by the output volume. Nothing to see here really
         auto f = config.outputVolume * genNextPlaybackSample();
@@ -83,101 +100,319 @@ void AudioHandler::audioCallback(void* out, void* in, size_t len)
         outPtr[i] = static_cast<float>(f); //NOLINT
         outPtr[i + 1] = static_cast<float>(f); //NOLINT
 
+        if (!capturing) {
+            continue;
+        }
+
         // input
         // samples are coming in as flaot32, but the stream is a raw pointer.
         auto reference = ptr[i + (config.inputAndReferenceAreSwapped ? 1 : 0)]; // NOLINT
         auto input = ptr[i + (config.inputAndReferenceAreSwapped ? 0 : 1)]; // NOLINT
-        // and convert to double, as we wanna process stuff as double
-        auto dReference = static_cast<double>(reference);
-        auto dInput = static_cast<double>(input);
+        // and convert to whatever precision we process in
+        auto dReference = static_cast<Real>(reference);
+        auto dInput = static_cast<Real>(input);
 
-        // we put the samples back at the end of our current state
-        captureState->accessData().reference[sampleCount] = dReference;
-        captureState->accessData().input[sampleCount] = dInput;
-        ++sampleCount;
+        // we put the samples into the capture rings
+        referenceRing[ringWrite] = dReference;
+        inputRing[ringWrite] = dInput;
+        ringWrite = (ringWrite + 1) & ringMask;
+        ringFill = std::min(ringFill + 1, inputRing.size());
+        ++hopCount;
+        if (++sweepCount >= captureLength) {
+            sweepCount = 0;
+        }
 
-        // and if the current state is full, we put it into processStates.
+        // every hop, once there is enough for a whole frame, we cut one out of the rings into a state and put it into processStates.
         // we do not yet increase framecount - thats done by the audio processing thread.
-        // also, as we are already locking anyway, try to set up the next captureState. same as at the top, really
-        if (sampleCount >= config.analysisSamples) {
-            callbackLock.lock();
-            sampleCount = 0; // dont forget this!
-            processStates.push(captureState);
-            captureState = nullptr;
-
-            if (unusedStates.empty()) {
-                callbackLock.unlock();
-                return;
+        // if there is no unused state, that frame is lost. We keep count, so the pool can be sized properly.
+        // processStates can hold the whole pool, so the push cannot fail.
+        if (ringFill >= captureLength && (sweeping ? sweepCount == 0 : hopCount >= hop)) {
+            hopCount = 0; // dont forget this!
+            State* state = nullptr;
+            if (unusedStates.pop(state)) {
+                cutFrame(*state);
+                processStates.push(state);
+                workerWakeup.post();
+                poolStarved = false;
+            } else {
+                droppedFrames.fetch_add(1, std::memory_order_relaxed);
+                droppedSamples.fetch_add(hop, std::memory_order_relaxed);
+                if (!poolStarved) {
+                    poolStarvations.fetch_add(1, std::memory_order_relaxed);
+                    poolStarved = true;
+                    workerWakeup.post(); // the worker might want to grow the pool
+                }
             }
-            sweepGenerator.reset(); // so they are somewhat in sync
-            captureState = unusedStates.front();
-            unusedStates.pop();
-            callbackLock.unlock();
         }
     }
 }
 
+void AudioHandler::cutFrame(State& state) noexcept
+{
+    // the frame ends at ringWrite, so it starts captureLength samples before that.
+    // the ring size is a power of two, and it might wrap around, so copy in two parts
+    auto& data = state.accessData();
+    const size_t ringSize = inputRing.size();
+    const size_t start = (ringWrite + ringSize - captureLength) & (ringSize - 1);
+    const size_t firstPart = std::min(captureLength, ringSize - start);
+    const auto begin = static_cast<std::ptrdiff_t>(start);
+    const auto firstEnd = static_cast<std::ptrdiff_t>(start + firstPart);
+    const auto secondEnd = static_cast<std::ptrdiff_t>(captureLength - firstPart);
+
+    std::copy(inputRing.begin() + begin, inputRing.begin() + firstEnd, data.input.begin());
+    std::copy(referenceRing.begin() + begin, referenceRing.begin() + firstEnd, data.reference.begin());
+    std::copy(inputRing.begin(), inputRing.begin() + secondEnd, data.input.begin() + static_cast<std::ptrdiff_t>(firstPart));
+    std::copy(referenceRing.begin(), referenceRing.begin() + secondEnd, data.reference.begin() + static_cast<std::ptrdiff_t>(firstPart));
+}
+
+void AudioHandler::applyWorkerScheduling(const ThreadSchedulingConfig& scheduling, std::string& priorityError, int& avoidedCpu) noexcept
+{
+    // priority first. If we are not allowed to, we keep running with what we have
+    if (avoidedCpu == -2) {
+        priorityError = applyThreadPriority(scheduling);
+    }
+
+    // the audio callback might have been pinned since. Only a syscall if it was.
+    int cpu = scheduling.avoidAudioCpu ? audioCpu.load(std::memory_order_relaxed) : -1;
+    if (cpu == avoidedCpu) {
+        return;
+    }
+    avoidedCpu = cpu;
+    auto affinityError = applyThreadAffinity(scheduling, cpu);
+    std::lock_guard<std::mutex> lock(schedulingLock);
+    schedulingStatus = priorityError.empty() || affinityError.empty() ? priorityError + affinityError : priorityError + "; " + affinityError;
+}
+
+bool AudioHandler::takeFrame(Frame& frame) noexcept
+{
+    // the pool ran dry since someone last looked. if we are allowed to, make it bigger
+    size_t starvations = poolStarvations;
+    if (handledStarvations.exchange(starvations) != starvations && poolPolicy == PoolPolicy::Grow) {
+        growPool();
+    }
+
+    // the lock makes sure only one thread at a time is the consumer of processStates. resetStates drains it as well.
+    // the sequence number remembers the capture order, as frames might finish out of order
+    // holding a reference keeps resetStates from handing the state back to the capture while we work on it.
+    State* popped = nullptr;
+    std::lock_guard<std::mutex> lock(processingLock);
+    if (!processStates.pop(popped)) {
+        return false;
+    }
+
+    // if we are behind, only the newest frame is interesting. The others go right back to the capture.
+    State* newer = nullptr;
+    while (poolPolicy == PoolPolicy::OverwriteOldest && processStates.pop(newer)) {
+        unusedStates.push(popped);
+        popped = newer;
+        droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        droppedSamples.fetch_add(captureHop.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    frame.state = popped->shared_from_this();
+    frame.generation = poolGeneration;
+    frame.sequence = nextSequence++;
+
+    // settings change at frame boundaries. The ui never frees the version we load here,
+    // as it is at least as new as the one we acked last. We are the only one here, thanks to the lock.
+    const auto* settings = currentSettings.load(std::memory_order_acquire);
+    frame.state->setSettings(*settings);
+    settingsAck.store(settings->version, std::memory_order_release);
+    return true;
+}
+
 // processes audio samples. What this really means is, get them form the queue and call calc
-void AudioHandler::processingWorker() noexcept
+// there can be several of these running at once.
+void AudioHandler::processingWorker(ThreadSchedulingConfig scheduling) noexcept
 {
-    // needed for sleep
-    using namespace std::chrono;
+    std::string priorityError;
+    int avoidedCpu = -2;
+    applyWorkerScheduling(scheduling, priorityError, avoidedCpu);
 
     // terminateThreads is called in the dtor of AudioHandler and kills us of.
     while (!terminateThreads) {
-        // sleep (yield?) so that we dont eat all the cpu time when idle
-        std::this_thread::sleep_for(5ms);
-
-        // current is our current audio state.
-        // lock, see if there is something in the queue.
-        StatePtr current = nullptr;
-        callbackLock.lock();
-        if (!processStates.empty()) {
-            current = processStates.front();
-            processStates.pop();
+        // sleep until the callback tells us there is something to do.
+        // no frame is lost if we over-count, we just find nothing in processStates
+        workerWakeup.wait();
+        if (terminateThreads) {
+            break;
         }
-        callbackLock.unlock();
+        applyWorkerScheduling(scheduling, priorityError, avoidedCpu);
 
         // if there was nothing, we got nothing to do
-        if (!current) {
+        Frame frame;
+        if (!takeFrame(frame)) {
             continue;
         }
 
         // this takes time, and is the reason we are a thread
-        current->calc(stateFilterConfig);
+        frame.state->calcSpectrum(framePool);
+        finishFrame(frame.state, frame.sequence, frame.generation);
+    }
+}
+
+// the pipeline does the same as processingWorker, but each stage has its own thread.
+// the stages hand frames over in capture order, so several frames are worked on at once without any reordering.
+// on stop, each stage finishes what is queued up in front of it and then closes the queue behind it.
+void AudioHandler::fftStage(ThreadSchedulingConfig scheduling) noexcept
+{
+    std::string priorityError;
+    int avoidedCpu = -2;
+    applyWorkerScheduling(scheduling, priorityError, avoidedCpu);
+
+    while (!terminateThreads) {
+        workerWakeup.wait();
+        if (terminateThreads) {
+            break;
+        }
+        applyWorkerScheduling(scheduling, priorityError, avoidedCpu);
+
+        Frame frame;
+        if (!takeFrame(frame)) {
+            continue;
+        }
+
+        frame.state->calcFft(framePool);
+        // blocks while the next stage is behind
+        fftQueue.push(std::move(frame));
+    }
+    fftQueue.close();
+}
+
+void AudioHandler::spectralStage(ThreadSchedulingConfig scheduling) noexcept
+{
+    std::string priorityError;
+    int avoidedCpu = -2;
+    applyWorkerScheduling(scheduling, priorityError, avoidedCpu);
+
+    Frame frame;
+    while (fftQueue.pop(frame)) {
+        applyWorkerScheduling(scheduling, priorityError, avoidedCpu);
+        frame.state->calcSpectralProducts(framePool);
+        spectralQueue.push(std::move(frame));
+    }
+    spectralQueue.close();
+}
+
+void AudioHandler::smoothingStage(ThreadSchedulingConfig scheduling) noexcept
+{
+    std::string priorityError;
+    int avoidedCpu = -2;
+    applyWorkerScheduling(scheduling, priorityError, avoidedCpu);
+
+    Frame frame;
+    while (spectralQueue.pop(frame)) {
+        applyWorkerScheduling(scheduling, priorityError, avoidedCpu);
+        frame.state->calcSmoothing(framePool);
+        finishFrame(frame.state, frame.sequence, frame.generation);
+        // let go of the state, so it can be recycled
+        frame = Frame();
+    }
+}
+
+void AudioHandler::finishFrame(const StatePtr& state, size_t sequence, size_t generation) noexcept
+{
+    std::unique_lock<std::mutex> lock(processingLock);
+    // if there was a reset in the meantime, state belongs to a pool that is not in use anymore.
+    // nothing gets published, so this is the chance to hand back whatever the other threads let go of
+    if (generation != poolGeneration) {
+        recycleStates();
+        return;
+    }
+
+    // if someone else is already publishing, they will pick our frame up once its turn comes
+    finishedFrames[sequence] = state;
+    if (publishing) {
+        return;
+    }
+
+    publishing = true;
+    while (!finishedFrames.empty() && finishedFrames.begin()->first == nextPublish) {
+        StatePtr next = finishedFrames.begin()->second;
+        finishedFrames.erase(finishedFrames.begin());
+
+        // averaging takes a moment, dont block the other workers and the ui meanwhile
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> avgLock(averageLock);
+            next->calcAverage(stateFilterConfig, framePool);
+        }
+        lock.lock();
+
+        // reset while we were averaging. resetStates took care of publishing.
+        // next was retired by the reset, so it can go back right away
+        if (generation != poolGeneration) {
+            next.reset();
+            recycleStates();
+            return;
+        }
+
+        // copy some config infos over into the state
+        auto& data = next->accessData();
+        data.sampleRate = captureSampleRate;
+        data.fftDuration = static_cast<double>(data.fftLen) / captureSampleRate;
+        // what frameCount will be once this frame is out. tells the ui apart frames that reuse the same state
+        data.serial = frameCount.load() + 1;
 
         // advance the doneState
-        // we give the current state back to the unused queue, to be picked back up by the audio capture.
-        processingLock.lock();
+        // the ui gets the data without a copy. From here on, nobody writes to it until it comes back to the capture.
+        // the old done state retires, and goes back to the capture once the ui let go of it.
+        std::atomic_store(&publishedData, StateDataPtr(next, &next->getData()));
         if (doneState != nullptr) {
-            callbackLock.lock();
-            unusedStates.push(doneState);
-            callbackLock.unlock();
+            retiredStates.push_back(std::move(doneState));
         }
-        doneState = current;
+        doneState = std::move(next);
+        ++nextPublish;
         ++frameCount; // here we finally increase the frame count - just after updating the done state.
-        processingLock.unlock();
+
+        recycleStates();
     }
+    publishing = false;
 }
 
-// return a copy of the state data
-StateData AudioHandler::getStateData() const noexcept
+void AudioHandler::recycleStates() noexcept
 {
-    // first check if there is any. if not, nothing to do
-    StateData copy = {};
-    if (doneState == nullptr) {
-        return copy;
+    // the pool and retiredStates hold one reference each. Anything more is the ui or a worker.
+    auto iter = retiredStates.begin();
+    while (iter != retiredStates.end()) {
+        if (iter->use_count() == 2) {
+            // make sure we see everything the last user did before letting it go
+            std::atomic_thread_fence(std::memory_order_acquire);
+            unusedStates.push(iter->get());
+            iter = retiredStates.erase(iter);
+        } else {
+            ++iter;
+        }
     }
+}
 
-    // only the processor touches the done state
-    // the processor only locks the callbacks if it can lock this lock
-    // so no need to do anything special, the processor can wait for the copy
+void AudioHandler::growPool() noexcept
+{
     processingLock.lock();
-    copy = doneState->getData();
+    size_t length = captureLength;
+    size_t generation = poolGeneration;
+    size_t count = poolStateCount;
+    size_t memory = poolMemory;
     processingLock.unlock();
 
-    // copy some config infos over into the state
-    copy.sampleRate = static_cast<double>(config.sampleRate);
-    copy.fftDuration = config.samplesToSeconds(config.analysisSamples);
-    return copy;
+    // the rings have to be able to hold the whole pool, and we stay below the cap
+    if (count == 0 || count >= StateRing::capacity() || memory + memory / count > poolMemoryCap) {
+        return;
+    }
+
+    // state creation allocates, so not while holding the lock
+    auto state = std::make_shared<State>(length);
+
+    processingLock.lock();
+    if (generation == poolGeneration) {
+        statePool[length].push_back(state);
+        unusedStates.push(state.get());
+        updatePoolStats();
+    }
+    processingLock.unlock();
+}
+
+// return the published state data. no copy here
+StateDataPtr AudioHandler::getStateData() const noexcept
+{
+    return std::atomic_load(&publishedData);
 }
@@ -15,8 +15,10 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "../dsp/octavesmoothing.h"
 #include "../midpointslider.h"
 #include "audiohandler.h"
+#include "realtimeguard.h"
 
 std::string getStr(const FunctionGeneratorType& gen) noexcept
 {
@@ -40,15 +42,113 @@ std::string getStr(const FunctionGeneratorType& gen) noexcept
     return "";
 }
 
-std::string getStr(const StateWindowFilter& filter) noexcept
+std::string getStr(const WindowFunction& filter) noexcept
 {
     switch (filter) {
-    case StateWindowFilter::None:
+    case WindowFunction::None:
         return "None";
-    case StateWindowFilter::Hamming:
+    case WindowFunction::Hamming:
         return "Hamming";
-    case StateWindowFilter::Blackman:
+    case WindowFunction::Blackman:
         return "Blackman";
+    case WindowFunction::Hann:
+        return "Hann";
+    case WindowFunction::BlackmanHarris:
+        return "Blackman-Harris";
+    case WindowFunction::FlatTop:
+        return "Flat Top";
+    case WindowFunction::Kaiser:
+        return "Kaiser";
+    }
+
+    return "";
+}
+
+std::string getStr(const WindowScaling& scaling) noexcept
+{
+    switch (scaling) {
+    case WindowScaling::None:
+        return "No Window Correction";
+    case WindowScaling::CoherentGain:
+        return "Coherent Gain (Tones)";
+    case WindowScaling::Enbw:
+        return "ENBW (Noise)";
+    }
+
+    return "";
+}
+
+std::string getStr(const FftMode& mode) noexcept
+{
+    switch (mode) {
+    case FftMode::SeparateReal:
+        return "Two Real FFTs";
+    case FftMode::PackedComplex:
+        return "One Packed Complex FFT";
+    }
+
+    return "";
+}
+
+std::string getStr(const SpectrumEstimator& estimator) noexcept
+{
+    switch (estimator) {
+    case SpectrumEstimator::NeighbourBins:
+        return "Single Frame";
+    case SpectrumEstimator::CrossSpectrum:
+        return "Cross Spectrum";
+    }
+
+    return "";
+}
+
+std::string getStr(const SpectrumAveraging& averaging) noexcept
+{
+    switch (averaging) {
+    case SpectrumAveraging::Frames:
+        return "Last N Frames";
+    case SpectrumAveraging::Exponential:
+        return "Exponential";
+    case SpectrumAveraging::Infinite:
+        return "Infinite";
+    }
+
+    return "";
+}
+
+std::string getStr(const TransferEstimator& estimator) noexcept
+{
+    switch (estimator) {
+    case TransferEstimator::H1:
+        return "H1";
+    case TransferEstimator::H2:
+        return "H2";
+    }
+
+    return "";
+}
+
+std::string getStr(const PoolPolicy& policy) noexcept
+{
+    switch (policy) {
+    case PoolPolicy::DropNewest:
+        return "Drop Newest";
+    case PoolPolicy::OverwriteOldest:
+        return "Overwrite Oldest";
+    case PoolPolicy::Grow:
+        return "Grow";
+    }
+
+    return "";
+}
+
+std::string getStr(const ProcessingMode& mode) noexcept
+{
+    switch (mode) {
+    case ProcessingMode::WorkerPool:
+        return "Worker Pool";
+    case ProcessingMode::Pipeline:
+        return "Pipeline";
     }
 
     return "";
@@ -56,6 +156,13 @@ std::string getStr(const StateWindowFilter& filter) noexcept
 
 void AudioHandler::update() noexcept
 {
+    // a pool that finished building in the background, and states nobody holds anymore, go to the capture from here
+    checkPoolBuild();
+    // so do workers that were stopped in the background
+    checkWorkerRestart();
+    // and the pinning of the audio callback, which must not make syscalls itself
+    checkAudioThread();
+
     ImGui::Begin("Audio Settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysVerticalScrollbar);
     ImGui::PushItemWidth(-1.0F);
     if (!running) {
@@ -162,6 +269,19 @@ void AudioHandler::update() noexcept
     }
 
     ImGui::TextWrapped("Status: %s", status.c_str());
+    if (realtimeGuardEnabled()) {
+        ImGui::TextWrapped("Realtime Violations: %s", std::to_string(getRealtimeViolations()).c_str());
+        bool abortOnViolation = getAbortOnRealtimeViolation();
+        if (ImGui::Checkbox("Abort on Violation", &abortOnViolation)) {
+            setAbortOnRealtimeViolation(abortOnViolation);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(schedulingLock);
+        if (!schedulingStatus.empty()) {
+            ImGui::TextWrapped("Workers: %s", schedulingStatus.c_str());
+        }
+    }
 
     ImGui::Separator();
 
@@ -184,9 +304,12 @@ void AudioHandler::update() noexcept
         }
         ImGui::EndCombo();
     }
-    if (functionGeneratorType == FunctionGeneratorType::Sweep && stateFilterConfig.windowFilter != StateWindowFilter::None) {
+    if (functionGeneratorType == FunctionGeneratorType::Sweep && filterSettings.windowFilter != WindowFunction::None) {
         ImGui::TextWrapped("Disable Window Filter for Sweep!");
     }
+    if (functionGeneratorType == FunctionGeneratorType::Sweep && config.getAnalysisOverlap() > 0.0) {
+        ImGui::TextWrapped("Sweep cuts one frame per sweep, the overlap is not used");
+    }
 
     if (functionGeneratorType == FunctionGeneratorType::Sine) {
         auto freq = static_cast<float>(sineGenerator.getFrequency());
@@ -204,7 +327,10 @@ void AudioHandler::update() noexcept
         for (auto&& rate : config.getPossibleAnalysisSampleRates()) {
             ImGui::PushID(static_cast<int>(rate));
             if (ImGui::Selectable(config.sampleCountToString(rate).c_str(), rate == config.analysisSamples)) {
+                // keep the overlap, not the hop
+                auto overlap = config.getAnalysisOverlap();
                 config.analysisSamples = rate;
+                config.setAnalysisOverlap(overlap);
                 sweepGenerator.setLength(static_cast<double>(config.analysisSamples) / config.sampleRate);
                 resetStates();
             }
@@ -213,25 +339,280 @@ void AudioHandler::update() noexcept
 
         ImGui::EndCombo();
     }
+    ImGui::TextWrapped("Overlap");
+    auto overlapStr = [](double overlap) {
+        return std::to_string(overlap * 100.0).substr(0, 4) + "%";
+    };
+    if (ImGui::BeginCombo("##Overlap", overlapStr(config.getAnalysisOverlap()).c_str())) {
+        for (double overlap : { 0.0, 0.5, 0.75, 0.875 }) {
+            ImGui::PushID(static_cast<int>(overlap * 1000.0));
+            auto hop = static_cast<size_t>(static_cast<double>(config.analysisSamples) * (1.0 - overlap));
+            if (ImGui::Selectable(overlapStr(overlap).c_str(), hop == config.getAnalysisHop())) {
+                config.setAnalysisOverlap(overlap);
+                resetStates();
+            }
+            ImGui::PopID();
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::TextWrapped("Hop: %s", config.sampleCountToString(config.getAnalysisHop()).c_str());
+    auto iHop = static_cast<int>(config.getAnalysisHop());
+    if (ImGui::InputInt("##analysisHop", &iHop, static_cast<int>(AudioConfig::minAnalysisHop), 1024, ImGuiInputTextFlags_EnterReturnsTrue)) {
+        config.analysisHop = static_cast<size_t>(std::max(iHop, 1));
+        config.analysisHop = config.getAnalysisHop();
+        resetStates();
+    }
     ImGui::TextWrapped("Window Filter");
-    if (ImGui::BeginCombo("##Window Config", getStr(stateFilterConfig.windowFilter).c_str())) {
-        if (ImGui::Selectable("None", stateFilterConfig.windowFilter == StateWindowFilter::None)) {
-            stateFilterConfig.windowFilter = StateWindowFilter::None;
+    if (ImGui::BeginCombo("##Window Config", getStr(filterSettings.windowFilter).c_str())) {
+        for (auto filter : { WindowFunction::None, WindowFunction::Hamming, WindowFunction::Blackman, WindowFunction::Hann, WindowFunction::BlackmanHarris, WindowFunction::FlatTop, WindowFunction::Kaiser }) {
+            if (ImGui::Selectable(getStr(filter).c_str(), filterSettings.windowFilter == filter) && filterSettings.windowFilter != filter) {
+                filterSettings.windowFilter = filter;
+                publishSettings();
+            }
         }
-        if (ImGui::Selectable("Hamming", stateFilterConfig.windowFilter == StateWindowFilter::Hamming)) {
-            stateFilterConfig.windowFilter = StateWindowFilter::Hamming;
+        ImGui::EndCombo();
+    }
+    if (filterSettings.windowFilter == WindowFunction::Kaiser) {
+        ImGui::TextWrapped("Kaiser Beta");
+        auto beta = static_cast<float>(filterSettings.kaiserBeta);
+        if (ImGui::InputFloat("##kaiserBeta", &beta, 0.5F, 2.0F, "%.1f", ImGuiInputTextFlags_EnterReturnsTrue)) {
+            filterSettings.kaiserBeta = std::clamp(static_cast<double>(beta), 0.0, 40.0);
+            publishSettings();
         }
-        if (ImGui::Selectable("Blackman", stateFilterConfig.windowFilter == StateWindowFilter::Blackman)) {
-            stateFilterConfig.windowFilter = StateWindowFilter::Blackman;
+    }
+    if (ImGui::BeginCombo("##Window Scaling", getStr(filterSettings.windowScaling).c_str())) {
+        for (auto scaling : { WindowScaling::None, WindowScaling::CoherentGain, WindowScaling::Enbw }) {
+            if (ImGui::Selectable(getStr(scaling).c_str(), filterSettings.windowScaling == scaling) && filterSettings.windowScaling != scaling) {
+                filterSettings.windowScaling = scaling;
+                publishSettings();
+            }
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::TextWrapped("FFT Mode");
+    if (ImGui::BeginCombo("##FFT Mode", getStr(filterSettings.fftMode).c_str())) {
+        for (auto mode : { FftMode::SeparateReal, FftMode::PackedComplex }) {
+            if (ImGui::Selectable(getStr(mode).c_str(), filterSettings.fftMode == mode) && filterSettings.fftMode != mode) {
+                filterSettings.fftMode = mode;
+                publishSettings();
+            }
         }
         ImGui::EndCombo();
     }
     ImGui::TextWrapped("FFT Averaging");
-    auto iAvgCount = static_cast<int>(stateFilterConfig.avgCount);
-    ImGui::InputInt("##avgCount", &iAvgCount, 1, 1);
-    stateFilterConfig.avgCount = std::clamp(static_cast<size_t>(iAvgCount), static_cast<size_t>(0), LAA_MAX_FFT_AVG);
+    if (ImGui::BeginCombo("##Averaging Mode", getStr(filterSettings.avgMode).c_str())) {
+        for (auto averaging : { SpectrumAveraging::Frames, SpectrumAveraging::Exponential, SpectrumAveraging::Infinite }) {
+            if (ImGui::Selectable(getStr(averaging).c_str(), filterSettings.avgMode == averaging) && filterSettings.avgMode != averaging) {
+                filterSettings.avgMode = averaging;
+                publishSettings();
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (filterSettings.avgMode != SpectrumAveraging::Infinite) {
+        ImGui::TextWrapped(filterSettings.avgMode == SpectrumAveraging::Frames ? "Frames (0 for none)" : "Time Constant (Frames, 0 for none)");
+        auto iAvgCount = static_cast<int>(filterSettings.avgCount);
+        ImGui::InputInt("##avgCount", &iAvgCount, 1, 8);
+        auto newAvgCount = std::clamp(static_cast<size_t>(std::max(iAvgCount, 0)), static_cast<size_t>(0), LAA_MAX_FFT_AVG);
+        if (newAvgCount != filterSettings.avgCount) {
+            filterSettings.avgCount = newAvgCount;
+            publishSettings();
+        }
+        auto historyFrames = StateFilterConfig::historyFrames(filterSettings.avgCount, captureLength / 2 + 1);
+        if (filterSettings.avgMode == SpectrumAveraging::Frames && historyFrames < filterSettings.avgCount) {
+            ImGui::TextWrapped("Only %zu frames fit at this length", historyFrames);
+        }
+    }
+    // the history belongs to the workers. They clear it once they see this
     if (ImGui::Button("Reset Avg")) {
-        stateFilterConfig.clearAvg();
+        ++filterSettings.avgResetSerial;
+        publishSettings();
+    }
+    ImGui::TextWrapped("Smoothing");
+    auto fractionStr = [](size_t fraction) {
+        return fraction == 0 ? std::string("20 Bins") : "1/" + std::to_string(fraction) + " Octave";
+    };
+    if (ImGui::BeginCombo("##Smoothing", fractionStr(filterSettings.smoothingFraction).c_str())) {
+        for (size_t fraction : OctaveSmoothing::fractions) {
+            if (ImGui::Selectable(fractionStr(fraction).c_str(), filterSettings.smoothingFraction == fraction) && filterSettings.smoothingFraction != fraction) {
+                filterSettings.smoothingFraction = fraction;
+                publishSettings();
+            }
+        }
+        if (ImGui::Selectable(fractionStr(0).c_str(), filterSettings.smoothingFraction == 0) && filterSettings.smoothingFraction != 0) {
+            filterSettings.smoothingFraction = 0;
+            publishSettings();
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::TextWrapped("Transfer Function and Coherence");
+    if (ImGui::BeginCombo("##Spectrum Estimator", getStr(filterSettings.spectrumEstimator).c_str())) {
+        for (auto estimator : { SpectrumEstimator::NeighbourBins, SpectrumEstimator::CrossSpectrum }) {
+            if (ImGui::Selectable(getStr(estimator).c_str(), filterSettings.spectrumEstimator == estimator) && filterSettings.spectrumEstimator != estimator) {
+                filterSettings.spectrumEstimator = estimator;
+                publishSettings();
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (filterSettings.spectrumEstimator == SpectrumEstimator::CrossSpectrum) {
+        if (ImGui::BeginCombo("##Cross Spectrum Averaging", getStr(filterSettings.crossSpectrumAveraging).c_str())) {
+            for (auto averaging : { SpectrumAveraging::Frames, SpectrumAveraging::Exponential, SpectrumAveraging::Infinite }) {
+                if (ImGui::Selectable(getStr(averaging).c_str(), filterSettings.crossSpectrumAveraging == averaging) && filterSettings.crossSpectrumAveraging != averaging) {
+                    filterSettings.crossSpectrumAveraging = averaging;
+                    publishSettings();
+                }
+            }
+            ImGui::EndCombo();
+        }
+        if (filterSettings.crossSpectrumAveraging != SpectrumAveraging::Infinite) {
+            ImGui::TextWrapped(filterSettings.crossSpectrumAveraging == SpectrumAveraging::Frames ? "Frames" : "Time Constant (Frames)");
+            auto iFrames = static_cast<int>(filterSettings.crossSpectrumFrames);
+            ImGui::InputInt("##crossSpectrumFrames", &iFrames, 1, 4);
+            auto newFrames = std::clamp(static_cast<size_t>(std::max(iFrames, 1)), static_cast<size_t>(1), CrossSpectrumAccumulator::maxFrames);
+            if (newFrames != filterSettings.crossSpectrumFrames) {
+                filterSettings.crossSpectrumFrames = newFrames;
+                publishSettings();
+            }
+        }
+        if (ImGui::BeginCombo("##Transfer Estimator", getStr(filterSettings.transferEstimator).c_str())) {
+            for (auto estimator : { TransferEstimator::H1, TransferEstimator::H2 }) {
+                if (ImGui::Selectable(getStr(estimator).c_str(), filterSettings.transferEstimator == estimator) && filterSettings.transferEstimator != estimator) {
+                    filterSettings.transferEstimator = estimator;
+                    publishSettings();
+                }
+            }
+            ImGui::EndCombo();
+        }
+    }
+
+    ImGui::Separator();
+    constexpr size_t megabyte = 1024 * 1024;
+    {
+        // growPool might add to a pool meanwhile
+        std::lock_guard<std::mutex> lock(processingLock);
+        for (const auto& [length, pool] : statePool) {
+            size_t memory = 0;
+            bool hugePages = false;
+            for (const auto& state : pool) {
+                memory += state->memoryUsage();
+                hugePages = hugePages || state->getData().arena.hugePages();
+            }
+            ImGui::TextWrapped("State Pool %d: %d states, %.1f MB%s", static_cast<int>(length), static_cast<int>(pool.size()), static_cast<double>(memory) / static_cast<double>(megabyte), hugePages ? ", huge pages" : "");
+        }
+    }
+    if (poolBuild.valid()) {
+        ImGui::TextWrapped("Building State Pool %d...", static_cast<int>(poolBuildLength));
+    }
+    if (workerStop.valid()) {
+        ImGui::TextWrapped("Restarting Workers...");
+    }
+    ImGui::TextWrapped("Dropped Frames: %s", std::to_string(droppedFrames.load()).c_str());
+    ImGui::TextWrapped("Dropped Samples: %s", std::to_string(droppedSamples.load()).c_str());
+    ImGui::TextWrapped("Pool Starvations: %s", std::to_string(poolStarvations.load()).c_str());
+    if (ImGui::Button("Reset Counters")) {
+        droppedFrames = 0;
+        droppedSamples = 0;
+        poolStarvations = 0;
+    }
+    ImGui::TextWrapped("Precision: %s, %s", std::is_same_v<Real, float> ? "float" : "double", kernels().name);
+    ImGui::TextWrapped("Processing Mode");
+    if (ImGui::BeginCombo("##Processing Mode", getStr(processingMode).c_str())) {
+        for (auto mode : { ProcessingMode::WorkerPool, ProcessingMode::Pipeline }) {
+            if (ImGui::Selectable(getStr(mode).c_str(), mode == processingMode) && mode != processingMode) {
+                processingMode = mode;
+                restartWorkers();
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (processingMode == ProcessingMode::WorkerPool) {
+        ImGui::TextWrapped("Processing Threads");
+        auto iWorkers = static_cast<int>(workerCount);
+        ImGui::InputInt("##workerCount", &iWorkers, 1, 1);
+        auto newWorkerCount = std::clamp(static_cast<size_t>(std::max(iWorkers, 1)), static_cast<size_t>(1), static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u)));
+        if (newWorkerCount != workerCount) {
+            workerCount = newWorkerCount;
+            restartWorkers();
+        }
+        ImGui::TextWrapped("Queued Frames: %d", static_cast<int>(processStates.size()));
+    } else {
+        // where frames pile up is where the bottleneck is
+        ImGui::TextWrapped("Queued for FFT: %d", static_cast<int>(processStates.size()));
+        ImGui::TextWrapped("Queued for Coherence/IR: %d/%d", static_cast<int>(fftQueue.size()), static_cast<int>(fftQueue.maxSize()));
+        ImGui::TextWrapped("Queued for Smoothing: %d/%d", static_cast<int>(spectralQueue.size()), static_cast<int>(spectralQueue.maxSize()));
+    }
+    ImGui::TextWrapped("Extra Threads per Frame (0 for none)");
+    auto iFrameThreads = static_cast<int>(frameThreadCount);
+    ImGui::InputInt("##frameThreadCount", &iFrameThreads, 1, 1);
+    auto newFrameThreadCount = std::clamp(static_cast<size_t>(std::max(iFrameThreads, 0)), static_cast<size_t>(0), static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u)));
+    if (newFrameThreadCount != frameThreadCount) {
+        frameThreadCount = newFrameThreadCount;
+        restartWorkers();
+    }
+    if (ImGui::CollapsingHeader("Thread Scheduling")) {
+        bool schedulingChanged = false;
+        ImGui::TextWrapped("Worker Priority");
+        if (ImGui::BeginCombo("##Worker Priority", getStr(workerScheduling.priority).c_str())) {
+            for (auto priority : { ThreadPriority::Normal, ThreadPriority::Nice, ThreadPriority::RoundRobin, ThreadPriority::Fifo }) {
+                if (ImGui::Selectable(getStr(priority).c_str(), priority == workerScheduling.priority)) {
+                    schedulingChanged = workerScheduling.priority != priority;
+                    workerScheduling.priority = priority;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        if (workerScheduling.priority == ThreadPriority::Nice) {
+            ImGui::TextWrapped("Nice Level");
+            auto iNice = workerScheduling.niceLevel;
+            if (ImGui::InputInt("##niceLevel", &iNice, 1, 5, ImGuiInputTextFlags_EnterReturnsTrue)) {
+                workerScheduling.niceLevel = std::clamp(iNice, -20, 19);
+                schedulingChanged = true;
+            }
+        }
+        if (workerScheduling.priority == ThreadPriority::RoundRobin || workerScheduling.priority == ThreadPriority::Fifo) {
+            ImGui::TextWrapped("Realtime Priority");
+            auto iPriority = workerScheduling.realtimePriority;
+            if (ImGui::InputInt("##realtimePriority", &iPriority, 1, 10, ImGuiInputTextFlags_EnterReturnsTrue)) {
+                workerScheduling.realtimePriority = std::clamp(iPriority, 1, 99);
+                schedulingChanged = true;
+            }
+        }
+        ImGui::TextWrapped("Worker CPUs (e.g. 2,4-7, empty for all)");
+        if (ImGui::InputText("##workerCpus", &workerScheduling.cpuList, ImGuiInputTextFlags_EnterReturnsTrue)) {
+            schedulingChanged = true;
+        }
+        if (ImGui::Checkbox("Keep Workers off the Audio CPU", &workerScheduling.avoidAudioCpu)) {
+            schedulingChanged = true;
+        }
+        if (audioCpu.load() < 0) {
+            ImGui::TextWrapped("Audio CPU: not pinned, workers can only keep off it once it is");
+        } else {
+            ImGui::TextWrapped("Audio CPU: %d", audioCpu.load());
+        }
+        ImGui::TextWrapped("Pin Audio to CPU (-1 for none, applies on start)");
+        auto iAudioCpu = audioCpuPin.load();
+        if (ImGui::InputInt("##audioCpuPin", &iAudioCpu, 1, 1, ImGuiInputTextFlags_EnterReturnsTrue)) {
+            audioCpuPin = std::clamp(iAudioCpu, -1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+        }
+        if (schedulingChanged) {
+            restartWorkers();
+        }
+    }
+    ImGui::TextWrapped("When the Pool runs dry");
+    if (ImGui::BeginCombo("##Pool Policy", getStr(poolPolicy.load()).c_str())) {
+        for (auto policy : { PoolPolicy::DropNewest, PoolPolicy::OverwriteOldest, PoolPolicy::Grow }) {
+            if (ImGui::Selectable(getStr(policy).c_str(), policy == poolPolicy)) {
+                poolPolicy = policy;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (poolPolicy == PoolPolicy::Grow) {
+        ImGui::TextWrapped("Pool Memory Cap (MB)");
+        auto iCap = static_cast<int>(poolMemoryCap / megabyte);
+        ImGui::InputInt("##poolMemoryCap", &iCap, 64, 256);
+        poolMemoryCap = static_cast<size_t>(std::max(iCap, 1)) * megabyte;
     }
 
     ImGui::PopItemWidth();
@@ -0,0 +1,141 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_boundedqueue_h
+#define laa_boundedqueue_h
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/**
+ * \brief Blocking queue with a fixed maximum size, to hand frames from one pipeline stage to the next
+ * A full queue blocks the producer, so a slow stage holds up the stages in front of it instead of piling up frames.
+ * \note This locks. Never use it from the audio callback.
+ * \tparam T element type
+ */
+template <class T>
+class BoundedQueue {
+public:
+    /**
+     * \brief ctor
+     * \param maxSize maximum number of elements
+     */
+    explicit BoundedQueue(size_t maxSize) noexcept
+        : capacity(maxSize)
+    {
+    }
+
+    /**
+     * \brief Push a value, waiting for room if the queue is full
+     * \param value value to push
+     * \return false if the queue was closed
+     */
+    bool push(T value) noexcept
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [this]() {
+            return closed || queue.size() < capacity;
+        });
+        if (closed) {
+            return false;
+        }
+        queue.push_back(std::move(value));
+        guard.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * \brief Pop the oldest value, waiting for one if the queue is empty
+     * \param value receives the value
+     * \return false if the queue was closed and nothing is left in it
+     */
+    bool pop(T& value) noexcept
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [this]() {
+            return closed || !queue.empty();
+        });
+        if (queue.empty()) {
+            return false;
+        }
+        value = std::move(queue.front());
+        queue.pop_front();
+        guard.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * \brief Close the queue. Pushes fail from now on, pops drain what is left.
+     */
+    void close() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    /**
+     * \brief Open the queue again after \sa close
+     */
+    void reopen() noexcept
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = false;
+    }
+
+    /**
+     * \brief Number of elements currently in the queue
+     * \return element count
+     */
+    [[nodiscard]] size_t size() const noexcept
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return queue.size();
+    }
+
+    /**
+     * \brief Maximum number of elements
+     * \return capacity
+     */
+    [[nodiscard]] size_t maxSize() const noexcept
+    {
+        return capacity;
+    }
+
+private:
+    /// the elements
+    std::deque<T> queue = {};
+    /// maximum number of elements
+    size_t capacity = 0;
+    /// protects everything
+    mutable std::mutex lock = {};
+    /// signaled when something was popped
+    std::condition_variable notFull = {};
+    /// signaled when something was pushed
+    std::condition_variable notEmpty = {};
+    /// true after close
+    bool closed = false;
+};
+
+#endif //laa_boundedqueue_h
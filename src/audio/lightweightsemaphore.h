@@ -0,0 +1,107 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_lightweightsemaphore_h
+#define laa_lightweightsemaphore_h
+
+#include <atomic>
+#include <cerrno>
+#include <semaphore.h>
+
+/**
+ * \brief Counting semaphore that only goes to the kernel if someone actually sleeps
+ * The count lives in an atomic. post() only calls into the os semaphore if a waiter is blocked,
+ * so signaling a busy consumer is a single atomic add. post() never blocks, so the audio callback may call it.
+ */
+class LightweightSemaphore {
+public:
+    /// ctor
+    LightweightSemaphore() noexcept
+    {
+        sem_init(&osSemaphore, 0, 0);
+    }
+    /// dtor
+    ~LightweightSemaphore() noexcept
+    {
+        sem_destroy(&osSemaphore);
+    }
+    /// deleted
+    LightweightSemaphore(const LightweightSemaphore&) = delete;
+    /// deleted
+    LightweightSemaphore(LightweightSemaphore&&) = delete;
+    /// deleted
+    LightweightSemaphore& operator=(const LightweightSemaphore&) = delete;
+    /// deleted
+    LightweightSemaphore& operator=(LightweightSemaphore&&) = delete;
+
+    /**
+     * \brief Increase the count by one, waking up a waiter if there is one
+     */
+    void post() noexcept
+    {
+        // a negative count means someone is (about to be) sleeping in the os semaphore
+        if (count.fetch_add(1, std::memory_order_release) < 0) {
+            sem_post(&osSemaphore);
+        }
+    }
+
+    /**
+     * \brief Decrease the count by one, sleeping until that is possible
+     */
+    void wait() noexcept
+    {
+        // spin a little first, posts often come in right after we ran out
+        for (int i = 0; i < spinCount; i++) {
+            if (tryWait()) {
+                return;
+            }
+        }
+
+        if (count.fetch_sub(1, std::memory_order_acquire) > 0) {
+            return;
+        }
+
+        // we took our count in advance, now wait for the post that gives it to us
+        while (sem_wait(&osSemaphore) != 0 && errno == EINTR) {
+        }
+    }
+
+    /**
+     * \brief Decrease the count by one if that is possible without waiting
+     * \return true if the count was decreased
+     */
+    bool tryWait() noexcept
+    {
+        auto current = count.load(std::memory_order_relaxed);
+        while (current > 0) {
+            if (count.compare_exchange_weak(current, current - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    /// how often wait() tries before going to sleep
+    static constexpr int spinCount = 64;
+    /// the actual count. negative values are the number of sleepers
+    std::atomic<long> count = { 0 };
+    /// where sleepers sleep
+    sem_t osSemaphore = {};
+};
+
+#endif //laa_lightweightsemaphore_h
@@ -0,0 +1,332 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "realtimeguard.h"
+
+#ifndef LAA_RT_GUARD
+
+RealtimeScope::RealtimeScope() noexcept = default;
+RealtimeScope::~RealtimeScope() noexcept = default;
+
+size_t getRealtimeViolations() noexcept
+{
+    return 0;
+}
+
+void setAbortOnRealtimeViolation(bool) noexcept
+{
+}
+
+bool getAbortOnRealtimeViolation() noexcept
+{
+    return false;
+}
+
+#else
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <pthread.h>
+#include <unistd.h>
+
+// the hooks sit in front of the glibc allocator. cmake only offers LAA_RT_GUARD where there is one
+#ifndef __GLIBC__
+#error "LAA_RT_GUARD needs glibc"
+#endif
+
+#include <dlfcn.h>
+
+// everything in here might run before main, after main, or in the middle of an allocation.
+// so: no allocations, no locks, no iostreams. Only atomics and write(2).
+
+namespace {
+/// true while the thread is inside a RealtimeScope
+thread_local bool realtimeThread = false;
+/// number of violations so far
+std::atomic<size_t> violations = { 0 };
+/// abort on violation
+std::atomic<bool> abortOnViolation = { false };
+
+/**
+ * \brief Report a violation if the calling thread is a realtime thread
+ * \param what what happened, as a string literal
+ * \param length length of what
+ */
+void check(const char* what, size_t length) noexcept
+{
+    if (!realtimeThread) {
+        return;
+    }
+
+    // a regression in the callback triggers this thousands of times per second. Only print on powers of two.
+    auto count = violations.fetch_add(1, std::memory_order_relaxed) + 1;
+    if ((count & (count - 1)) == 0 || abortOnViolation) {
+        constexpr char prefix[] = "LAA realtime violation: ";
+        // nothing sensible to do if stderr is gone
+        [[maybe_unused]] auto res = write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+        res = write(STDERR_FILENO, what, length);
+        res = write(STDERR_FILENO, "\n", 1);
+    }
+
+    if (abortOnViolation) {
+        std::abort();
+    }
+}
+
+/// check() with the length of a string literal
+template <size_t N>
+void check(const char (&what)[N]) noexcept
+{
+    check(what, N - 1);
+}
+}
+
+// glibc exports its allocator under these names, so we can sit in front of the public ones
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+/// the real pthread_mutex_lock
+using MutexLockFunc = int (*)(pthread_mutex_t*);
+
+/**
+ * \brief Look up the real pthread_mutex_lock
+ * \return the function
+ */
+MutexLockFunc realMutexLock() noexcept
+{
+    // dlsym returns a void*, there is no way around the cast. NOLINTNEXTLINE
+    return reinterpret_cast<MutexLockFunc>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+}
+
+/// looked up before main, so the audio thread never has to
+MutexLockFunc mutexLock = realMutexLock();
+}
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+    check("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    check("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    check("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+    if (ptr != nullptr) {
+        check("free");
+    }
+    __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    check("pthread_mutex_lock");
+    // someone might lock before our static init ran
+    if (mutexLock == nullptr) {
+        mutexLock = realMutexLock();
+    }
+    return mutexLock(mutex);
+}
+}
+
+namespace {
+/// malloc, without the check
+void* rawMalloc(size_t size) noexcept
+{
+    return __libc_malloc(size);
+}
+/// free, without the check
+void rawFree(void* ptr) noexcept
+{
+    __libc_free(ptr);
+}
+}
+
+namespace {
+/// what the replaced operator new does
+void* checkedNew(size_t size, bool nothrow)
+{
+    check("operator new");
+    void* ptr = rawMalloc(size == 0 ? 1 : size);
+    if (ptr == nullptr && !nothrow) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+/// what the replaced aligned operator new does
+void* checkedAlignedNew(size_t size, std::align_val_t alignment, bool nothrow)
+{
+    check("operator new");
+    auto align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    size = (size + align - 1) & ~(align - 1);
+    void* ptr = std::aligned_alloc(align, size == 0 ? align : size);
+    if (ptr == nullptr && !nothrow) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+/// what the replaced operator delete does
+void checkedDelete(void* ptr) noexcept
+{
+    if (ptr != nullptr) {
+        check("operator delete");
+    }
+    rawFree(ptr);
+}
+}
+
+// NOLINTNEXTLINE
+void* operator new(size_t size)
+{
+    return checkedNew(size, false);
+}
+
+// NOLINTNEXTLINE
+void* operator new[](size_t size)
+{
+    return checkedNew(size, false);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return checkedNew(size, true);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return checkedNew(size, true);
+}
+
+// NOLINTNEXTLINE
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return checkedAlignedNew(size, alignment, false);
+}
+
+// NOLINTNEXTLINE
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return checkedAlignedNew(size, alignment, false);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return checkedAlignedNew(size, alignment, true);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return checkedAlignedNew(size, alignment, true);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    checkedDelete(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    checkedDelete(ptr);
+}
+
+RealtimeScope::RealtimeScope() noexcept
+{
+    realtimeThread = true;
+}
+
+RealtimeScope::~RealtimeScope() noexcept
+{
+    realtimeThread = false;
+}
+
+size_t getRealtimeViolations() noexcept
+{
+    return violations.load(std::memory_order_relaxed);
+}
+
+void setAbortOnRealtimeViolation(bool abort) noexcept
+{
+    abortOnViolation = abort;
+}
+
+bool getAbortOnRealtimeViolation() noexcept
+{
+    return abortOnViolation;
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_realtimeguard_h
+#define laa_realtimeguard_h
+
+#include <cstddef>
+
+/**
+ * \brief Marks the calling thread as realtime for its lifetime
+ * With LAA_RT_GUARD defined, every allocation, free or mutex lock on a marked thread is reported
+ * on stderr and counted, \sa getRealtimeViolations. Without it, this does nothing.
+ * \note Does not nest.
+ */
+class RealtimeScope {
+public:
+    /// ctor
+    RealtimeScope() noexcept;
+    /// dtor
+    ~RealtimeScope() noexcept;
+    /// deleted
+    RealtimeScope(const RealtimeScope&) = delete;
+    /// deleted
+    RealtimeScope(RealtimeScope&&) = delete;
+    /// deleted
+    RealtimeScope& operator=(const RealtimeScope&) = delete;
+    /// deleted
+    RealtimeScope& operator=(RealtimeScope&&) = delete;
+};
+
+/**
+ * \brief Check if the realtime guard is compiled in
+ * \return true if LAA_RT_GUARD is defined
+ */
+constexpr bool realtimeGuardEnabled() noexcept
+{
+#ifdef LAA_RT_GUARD
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * \brief Number of allocations and locks done on realtime threads so far
+ * \return violation count. Always 0 without LAA_RT_GUARD
+ */
+size_t getRealtimeViolations() noexcept;
+
+/**
+ * \brief Abort on the next violation instead of only reporting it
+ * \param abort true to abort
+ */
+void setAbortOnRealtimeViolation(bool abort) noexcept;
+
+/**
+ * \brief Check if violations abort
+ * \return true if they do
+ */
+bool getAbortOnRealtimeViolation() noexcept;
+
+#endif //laa_realtimeguard_h
@@ -0,0 +1,108 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_spscring_h
+#define laa_spscring_h
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * \brief Wait-free single producer, single consumer ring buffer
+ * Exactly one thread may push and exactly one thread may pop at any given time.
+ * Neither side ever blocks or allocates, so this is safe to use from the audio callback.
+ * \tparam T Element type. Must be trivially copyable (we shuffle raw pointers around)
+ * \tparam Capacity Number of slots. Must be a power of two.
+ */
+template <class T, size_t Capacity>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>, "SpscRing only holds trivially copyable types");
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    /**
+     * \brief Push a value. Producer side only.
+     * \param value value to push
+     * \return false if the ring is full
+     */
+    bool push(const T& value) noexcept
+    {
+        const size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) >= Capacity) {
+            return false;
+        }
+
+        slots[currentTail & (Capacity - 1)] = value;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief Pop the oldest value. Consumer side only.
+     * \param value receives the value
+     * \return false if the ring is empty
+     */
+    bool pop(T& value) noexcept
+    {
+        const size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = slots[currentHead & (Capacity - 1)];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief Number of elements currently in the ring
+     * \note Only a snapshot if called while the other side is active
+     * \return element count
+     */
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \brief Check if there is anything in the ring
+     * \return true if empty
+     */
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    /**
+     * \brief Maximum number of elements
+     * \return Capacity
+     */
+    [[nodiscard]] static constexpr size_t capacity() noexcept
+    {
+        return Capacity;
+    }
+
+private:
+    // head and tail are on their own cache lines so producer and consumer do not fight over them
+    alignas(64) std::atomic<size_t> head = { 0 };
+    alignas(64) std::atomic<size_t> tail = { 0 };
+    alignas(64) std::array<T, Capacity> slots = {};
+};
+
+#endif //laa_spscring_h
@@ -0,0 +1,128 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "taskpool.h"
+
+#include <algorithm>
+
+TaskPool::~TaskPool() noexcept
+{
+    stop();
+}
+
+void TaskPool::start(size_t threadCount, const std::function<void()>& init) noexcept
+{
+    stop();
+
+    terminate = false;
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back([this, init]() {
+            if (init) {
+                init();
+            }
+            worker();
+        });
+    }
+    runningThreads = threadCount;
+}
+
+void TaskPool::stop() noexcept
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        terminate = true;
+    }
+    jobAdded.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    runningThreads = 0;
+}
+
+size_t TaskPool::threadCount() const noexcept
+{
+    return runningThreads;
+}
+
+void TaskPool::run(size_t taskCount, const std::function<void(size_t)>& task) noexcept
+{
+    if (taskCount == 0) {
+        return;
+    }
+
+    // nobody to share with
+    if (threadCount() == 0 || taskCount == 1) {
+        for (size_t i = 0; i < taskCount; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    Job job;
+    job.task = &task;
+    job.count = taskCount;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(&job);
+    }
+    jobAdded.notify_all();
+
+    // help out until there is nothing left to hand out
+    size_t executed = 0;
+    for (size_t index = job.next++; index < taskCount; index = job.next++) {
+        task(index);
+        ++executed;
+    }
+
+    // the threads only touch the job under the lock, so once it is out of the queue and done, it is ours again
+    std::unique_lock<std::mutex> guard(lock);
+    job.done += executed;
+    jobs.erase(std::remove(jobs.begin(), jobs.end(), &job), jobs.end());
+    jobDone.wait(guard, [&job]() {
+        return job.done == job.count;
+    });
+}
+
+void TaskPool::worker() noexcept
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        jobAdded.wait(guard, [this]() {
+            return terminate || !jobs.empty();
+        });
+        if (terminate) {
+            return;
+        }
+
+        // take an index of the oldest job. if there is none left, the job is out of work for us
+        Job* job = jobs.front();
+        size_t index = job->next++;
+        if (index >= job->count) {
+            jobs.pop_front();
+            continue;
+        }
+
+        guard.unlock();
+        (*job->task)(index);
+        guard.lock();
+
+        if (++job->done == job->count) {
+            jobDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,146 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_taskpool_h
+#define laa_taskpool_h
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Small fork-join pool to split up the work on a single frame
+ * Any number of threads can hand work to the pool at the same time. The calling thread always
+ * helps with its own tasks, so a pool without threads just runs everything in the caller.
+ * \note Never use this from the audio callback, it allocates and locks.
+ */
+class TaskPool {
+public:
+    /// ctor. starts without threads
+    TaskPool() noexcept = default;
+    /// dtor
+    ~TaskPool() noexcept;
+    /// deleted
+    TaskPool(const TaskPool&) = delete;
+    /// deleted
+    TaskPool(TaskPool&&) = delete;
+    /// deleted
+    TaskPool& operator=(const TaskPool&) = delete;
+    /// deleted
+    TaskPool& operator=(TaskPool&&) = delete;
+
+    /**
+     * \brief Spin up count threads, after stopping the current ones
+     * \note Nobody may be in run() while this is called
+     * \param count number of threads. 0 runs everything in the caller.
+     * \param init every thread calls this once before it picks up work, if set
+     */
+    void start(size_t count, const std::function<void()>& init = {}) noexcept;
+
+    /**
+     * \brief Stop all threads
+     * \note Nobody may be in run() while this is called
+     */
+    void stop() noexcept;
+
+    /**
+     * \brief Number of threads in the pool, not counting callers
+     * \return thread count
+     */
+    [[nodiscard]] size_t threadCount() const noexcept;
+
+    /**
+     * \brief Run task(0) ... task(count - 1), spread over the pool and the caller
+     * \param count number of tasks
+     * \param task the task. Gets its index.
+     */
+    void run(size_t count, const std::function<void(size_t)>& task) noexcept;
+
+    /**
+     * \brief Run a number of different tasks in parallel
+     * \param tasks the tasks
+     */
+    void run(std::initializer_list<std::function<void()>> tasks) noexcept
+    {
+        run(tasks.size(), [&tasks](size_t index) {
+            // initializer lists only have iterators. NOLINTNEXTLINE
+            (*(tasks.begin() + index))();
+        });
+    }
+
+    /**
+     * \brief Split [0, count) into ranges and run func(begin, end) on them in parallel
+     * \param count size of the range
+     * \param minChunk ranges are not made smaller than this
+     * \param func gets called with each range
+     */
+    template <class Func>
+    void parallelFor(size_t count, size_t minChunk, Func&& func) noexcept
+    {
+        // a few more ranges than threads, so a thread that got interrupted does not hold up everyone else
+        size_t chunks = std::min((threadCount() + 1) * 4, count / std::max(minChunk, static_cast<size_t>(1)));
+        if (chunks <= 1) {
+            func(static_cast<size_t>(0), count);
+            return;
+        }
+
+        run(chunks, [&](size_t chunk) {
+            func(count * chunk / chunks, count * (chunk + 1) / chunks);
+        });
+    }
+
+private:
+    /**
+     * \brief A call to run() the pool is working on
+     */
+    struct Job {
+        /// the task
+        const std::function<void(size_t)>* task = nullptr;
+        /// number of tasks
+        size_t count = 0;
+        /// next index to hand out
+        std::atomic<size_t> next = { 0 };
+        /// number of indices done. protected by lock
+        size_t done = 0;
+    };
+
+    /// what the threads do
+    void worker() noexcept;
+
+    /// the threads
+    std::vector<std::thread> threads = {};
+    /// jobs with indices left to hand out
+    std::deque<Job*> jobs = {};
+    /// protects jobs and Job::done
+    std::mutex lock = {};
+    /// signals new jobs
+    std::condition_variable jobAdded = {};
+    /// signals finished indices
+    std::condition_variable jobDone = {};
+    /// tells the threads to leave
+    bool terminate = false;
+    /// threads.size(), but safe to read from anywhere
+    std::atomic<size_t> runningThreads = { 0 };
+};
+
+#endif //laa_taskpool_h
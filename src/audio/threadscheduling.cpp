@@ -0,0 +1,216 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "threadscheduling.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::string getStr(const ThreadPriority& priority) noexcept
+{
+    switch (priority) {
+    case ThreadPriority::Normal:
+        return "Normal";
+    case ThreadPriority::Nice:
+        return "Nice";
+    case ThreadPriority::RoundRobin:
+        return "Realtime (RR)";
+    case ThreadPriority::Fifo:
+        return "Realtime (FIFO)";
+    }
+
+    return "";
+}
+
+std::vector<int> parseCpuList(const std::string& cpuList) noexcept
+{
+    // lets not go crazy with ranges like 0-2000000000
+    const int maxCpu = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1024);
+
+    std::vector<int> cpus;
+    std::stringstream stream(cpuList);
+    std::string part;
+    while (std::getline(stream, part, ',')) {
+        // "a" or "a-b"
+        auto dash = part.find('-');
+        std::string firstStr = part.substr(0, dash);
+        std::string lastStr = dash == std::string::npos ? firstStr : part.substr(dash + 1);
+        firstStr.erase(std::remove(firstStr.begin(), firstStr.end(), ' '), firstStr.end());
+        lastStr.erase(std::remove(lastStr.begin(), lastStr.end(), ' '), lastStr.end());
+
+        int first = 0;
+        int last = 0;
+        auto firstRes = std::from_chars(firstStr.data(), firstStr.data() + firstStr.size(), first);
+        auto lastRes = std::from_chars(lastStr.data(), lastStr.data() + lastStr.size(), last);
+        if (firstRes.ec != std::errc() || lastRes.ec != std::errc() || first < 0) {
+            continue;
+        }
+
+        for (int cpu = first; cpu <= last && cpu < maxCpu; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+#ifdef __linux__
+
+std::string applyThreadPriority(const ThreadSchedulingConfig& config) noexcept
+{
+    switch (config.priority) {
+    case ThreadPriority::Normal:
+        break;
+    case ThreadPriority::Nice: {
+        // on linux, nice levels are per thread
+        auto tid = static_cast<id_t>(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, tid, config.niceLevel) != 0) {
+            return std::string("Nice level not permitted (") + std::strerror(errno) + "), using normal priority";
+        }
+        break;
+    }
+    case ThreadPriority::RoundRobin:
+    case ThreadPriority::Fifo: {
+        int policy = config.priority == ThreadPriority::Fifo ? SCHED_FIFO : SCHED_RR;
+        sched_param param = {};
+        param.sched_priority = std::clamp(config.realtimePriority, sched_get_priority_min(policy), sched_get_priority_max(policy));
+        int err = pthread_setschedparam(pthread_self(), policy, &param);
+        if (err != 0) {
+            return std::string("Realtime scheduling not permitted (") + std::strerror(err) + "), using normal priority";
+        }
+        break;
+    }
+    }
+
+    return "";
+}
+
+std::string applyThreadAffinity(const ThreadSchedulingConfig& config, int avoidCpu) noexcept
+{
+    auto cpus = parseCpuList(config.cpuList);
+    if (cpus.empty()) {
+        // no list means all of them. Nothing to do, unless we need to avoid one
+        if (avoidCpu < 0) {
+            return "";
+        }
+        for (int cpu = 0; cpu < static_cast<int>(std::thread::hardware_concurrency()); cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int count = 0;
+    for (int cpu : cpus) {
+        if (cpu == avoidCpu || cpu >= CPU_SETSIZE) {
+            continue;
+        }
+        CPU_SET(static_cast<size_t>(cpu), &set);
+        ++count;
+    }
+
+    // rather share a cpu with the audio callback than not run at all
+    if (count == 0) {
+        return "No cpu left after avoiding the audio cpu, affinity unchanged";
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        return std::string("Could not set cpu affinity (") + std::strerror(err) + ")";
+    }
+
+    return "";
+}
+
+ThreadHandle currentThreadHandle() noexcept
+{
+    // a pthread_t is an unsigned long on linux
+    return static_cast<ThreadHandle>(pthread_self());
+}
+
+bool pinThread(ThreadHandle thread, int cpu) noexcept
+{
+    if (thread == 0 || cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<size_t>(cpu), &set);
+    return pthread_setaffinity_np(static_cast<pthread_t>(thread), sizeof(set), &set) == 0;
+}
+
+int pinnedCpu(ThreadHandle thread) noexcept
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (thread == 0 || pthread_getaffinity_np(static_cast<pthread_t>(thread), sizeof(set), &set) != 0 || CPU_COUNT(&set) != 1) {
+        return -1;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(static_cast<size_t>(cpu), &set)) {
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+#else
+
+std::string applyThreadPriority(const ThreadSchedulingConfig& config) noexcept
+{
+    if (config.priority != ThreadPriority::Normal) {
+        return "Thread priorities are not supported on this platform";
+    }
+    return "";
+}
+
+std::string applyThreadAffinity(const ThreadSchedulingConfig& config, int) noexcept
+{
+    if (!config.cpuList.empty()) {
+        return "Cpu affinity is not supported on this platform";
+    }
+    return "";
+}
+
+ThreadHandle currentThreadHandle() noexcept
+{
+    return 0;
+}
+
+bool pinThread(ThreadHandle, int) noexcept
+{
+    return false;
+}
+
+int pinnedCpu(ThreadHandle) noexcept
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_threadscheduling_h
+#define laa_threadscheduling_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \brief How a thread is scheduled
+ */
+enum class ThreadPriority {
+    /// whatever the thread inherited
+    Normal,
+    /// normal scheduling, but with a nice level
+    Nice,
+    /// SCHED_RR
+    RoundRobin,
+    /// SCHED_FIFO
+    Fifo
+};
+
+/**
+ * \brief Convert the ThreadPriority enum to a string
+ * \param priority ThreadPriority to stringify
+ * \return priority as a string
+ */
+std::string getStr(const ThreadPriority& priority) noexcept;
+
+/**
+ * \brief Scheduling settings for a group of threads
+ */
+struct ThreadSchedulingConfig {
+    /// scheduling class
+    ThreadPriority priority = ThreadPriority::Normal;
+    /// nice level for ThreadPriority::Nice. negative values need privileges
+    int niceLevel = -10;
+    /// priority for ThreadPriority::RoundRobin and ThreadPriority::Fifo
+    int realtimePriority = 10;
+    /// cpus the threads may run on, in the form "0,2-5". Empty means all of them.
+    std::string cpuList = "";
+    /// keep off the cpu the audio callback runs on
+    bool avoidAudioCpu = true;
+};
+
+/**
+ * \brief Parse a cpu list of the form "0,2-5"
+ * \param cpuList the list
+ * \return the cpus in the list. Garbage is ignored.
+ */
+std::vector<int> parseCpuList(const std::string& cpuList) noexcept;
+
+/**
+ * \brief Apply the priority part of config to the calling thread
+ * \param config the config
+ * \return empty if everything went fine, a description of what did not work otherwise
+ */
+std::string applyThreadPriority(const ThreadSchedulingConfig& config) noexcept;
+
+/**
+ * \brief Apply the cpu affinity part of config to the calling thread
+ * \param config the config
+ * \param avoidCpu a cpu to keep off of, or -1
+ * \return empty if everything went fine, a description of what did not work otherwise
+ */
+std::string applyThreadAffinity(const ThreadSchedulingConfig& config, int avoidCpu) noexcept;
+
+/// identifies a thread for pinThread and pinnedCpu. 0 for none
+using ThreadHandle = std::uint64_t;
+
+/**
+ * \brief Handle of the calling thread
+ * \note No syscall, no allocation, no lock. The audio callback hands this out, so others can pin it
+ * \return the handle, or 0 if threads can not be pinned on this platform
+ */
+ThreadHandle currentThreadHandle() noexcept;
+
+/**
+ * \brief Pin a thread to a single cpu
+ * \param thread handle of the thread. It has to be alive
+ * \param cpu the cpu
+ * \return true on success
+ */
+bool pinThread(ThreadHandle thread, int cpu) noexcept;
+
+/**
+ * \brief The cpu a thread is pinned to
+ * \param thread handle of the thread. It has to be alive
+ * \return the cpu, or -1 if the thread may run on several or it is not known
+ */
+int pinnedCpu(ThreadHandle thread) noexcept;
+
+#endif //laa_threadscheduling_h
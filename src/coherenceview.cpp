@@ -21,7 +21,7 @@ void CoherenceView::update(StateManager& stateManager, std::string idHint)
     ImGui::BeginChild((idHint + "Coherence").c_str());
 
     const auto& liveState = stateManager.getLive();
-    auto& data = choose(smoothing, liveState.smoothedCoherence, liveState.coherence);
+    auto& data = choose(smoothing, liveState.data->smoothedCoherence, liveState.data->coherence);
 
     auto size = ImGui::GetWindowContentRegionMax();
     PlotConfig plotConfig;
@@ -42,9 +42,9 @@ void CoherenceView::update(StateManager& stateManager, std::string idHint)
 
     if (liveState.visible) {
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = liveState.fftLen / 2;
+        sourceConfig.count = liveState.data->fftLen / 2;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = liveState.sampleRate / 2.0;
+        sourceConfig.xMax = liveState.data->sampleRate / 2.0;
         sourceConfig.color = liveState.uniqueCol;
         sourceConfig.active = liveState.active;
         Plot(
@@ -58,11 +58,11 @@ void CoherenceView::update(StateManager& stateManager, std::string idHint)
         if (!state.visible) {
             continue;
         }
-        auto& savedData = choose(smoothing, state.smoothedCoherence, state.coherence);
+        auto& savedData = choose(smoothing, state.data->smoothedCoherence, state.data->coherence);
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = state.fftLen / 2;
+        sourceConfig.count = state.data->fftLen / 2;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = state.sampleRate / 2.0;
+        sourceConfig.xMax = state.data->sampleRate / 2.0;
         sourceConfig.color = state.uniqueCol;
         sourceConfig.active = state.active;
         Plot(
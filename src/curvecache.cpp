@@ -0,0 +1,47 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "curvecache.h"
+
+const RealVec& CurveCache::get(const StateDataPtr& frame, ConstComplexSpan spectrum, Kernel kernel) noexcept
+{
+    // the same serial at the same address is the same frame, or a copy of it. Either way the values are the same
+    const size_t serial = frame == nullptr ? 0 : frame->serial;
+    for (auto& curve : curves) {
+        if (serial != 0 && curve.serial == serial && curve.spectrum == spectrum.data() && curve.kernel == kernel) {
+            curve.used = true;
+            return curve.values;
+        }
+    }
+
+    auto& curve = curves.emplace_back();
+    curve.serial = serial;
+    curve.spectrum = spectrum.data();
+    curve.kernel = kernel;
+    curve.values.resize(spectrum.size());
+    curve.used = true;
+    kernel(curve.values.data(), interleaved(spectrum.data()), spectrum.size());
+    return curve.values;
+}
+
+void CurveCache::prune() noexcept
+{
+    curves.remove_if([](const Curve& curve) { return !curve.used; });
+    for (auto& curve : curves) {
+        curve.used = false;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_curvecache_h
+#define laa_curvecache_h
+
+#include "state.h"
+
+#include <list>
+
+/**
+ * \brief Per bin values the views draw, made in one vectorized pass per frame instead of once per plotted point
+ * Curves do not hold on to their frames, so frames still go back to the pool while a view caches them.
+ * They are told apart by StateData::serial, which changes when a state is recycled even though its memory stays the same.
+ */
+class CurveCache {
+public:
+    /// one of the complex to real kernels, like kernels().phase
+    using Kernel = void (*)(Real* out, const Real* in, size_t count) noexcept;
+
+    /**
+     * \brief Get the kernel applied to a spectrum. Only runs the kernel if it was not asked for the same thing before
+     * \param frame frame the spectrum belongs to. Frames that were never published are never taken from the cache
+     * \param spectrum spectrum of frame
+     * \param kernel what to make of the spectrum
+     * \return values, as many as spectrum has bins. Valid until the next prune()
+     */
+    const RealVec& get(const StateDataPtr& frame, ConstComplexSpan spectrum, Kernel kernel) noexcept;
+
+    /**
+     * \brief Forget all curves get() was not asked for since the last prune()
+     */
+    void prune() noexcept;
+
+private:
+    struct Curve {
+        /// StateData::serial of the frame. A saved copy of a frame has the same serial, but its own spectra
+        size_t serial = 0;
+        /// start of the spectrum, which tells the spectra of a frame, and copies of it, apart
+        const Complex* spectrum = nullptr;
+        Kernel kernel = nullptr;
+        RealVec values = {};
+        bool used = false;
+    };
+    std::list<Curve> curves = {};
+};
+
+#endif //laa_curvecache_h
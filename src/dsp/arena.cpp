@@ -0,0 +1,108 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "arena.h"
+
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if defined(LAA_HUGE_PAGES) && defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace {
+/// madvise is linux only
+#if defined(LAA_HUGE_PAGES) && defined(__linux__)
+constexpr bool useHugePages = true;
+#else
+constexpr bool useHugePages = false;
+#endif
+}
+
+Arena::Arena(size_t arenaBytes, bool zero, bool hugePages) noexcept
+    : bytes(arenaBytes)
+    // only align to huge pages if we ask for them. malloc serves such alignments with a fresh mmap every time,
+    // and without huge pages every 4k page of it faults in one by one
+    , memoryAlignment(useHugePages && hugePages && arenaBytes >= hugePageSize ? hugePageSize : alignment)
+{
+    if (bytes == 0) {
+        return;
+    }
+
+    // like a vector in a noexcept ctor, running out of memory ends here
+    memory = static_cast<std::byte*>(::operator new(bytes, std::align_val_t(memoryAlignment)));
+
+#if defined(LAA_HUGE_PAGES) && defined(__linux__)
+    // before the first touch, so the pages are huge from the start. Only a hint, the kernel may say no
+    if (memoryAlignment == hugePageSize) {
+        huge = madvise(memory, bytes, MADV_HUGEPAGE) == 0;
+    }
+#endif
+
+    if (zero) {
+        std::memset(memory, 0, bytes);
+    }
+}
+
+Arena::~Arena() noexcept
+{
+    release();
+}
+
+Arena::Arena(Arena&& other) noexcept
+    : memory(std::exchange(other.memory, nullptr))
+    , bytes(std::exchange(other.bytes, 0))
+    , memoryAlignment(other.memoryAlignment)
+    , huge(std::exchange(other.huge, false))
+{
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        memory = std::exchange(other.memory, nullptr);
+        bytes = std::exchange(other.bytes, 0);
+        memoryAlignment = other.memoryAlignment;
+        huge = std::exchange(other.huge, false);
+    }
+    return *this;
+}
+
+std::byte* Arena::data() const noexcept
+{
+    return memory;
+}
+
+size_t Arena::size() const noexcept
+{
+    return bytes;
+}
+
+bool Arena::hugePages() const noexcept
+{
+    return huge;
+}
+
+void Arena::release() noexcept
+{
+    if (memory != nullptr) {
+        ::operator delete(memory, std::align_val_t(memoryAlignment));
+        memory = nullptr;
+    }
+}
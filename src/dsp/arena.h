@@ -0,0 +1,76 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_arena_h
+#define laa_arena_h
+
+#include <cstddef>
+
+/**
+ * \brief One zeroed, aligned block of memory for many arrays
+ * With the LAA_HUGE_PAGES cmake option, big arenas are aligned to huge pages and ask linux for transparent huge pages.
+ * A long state then needs a few tlb entries instead of thousands.
+ */
+class Arena {
+public:
+    /// alignment of the arena. Arrays in it should start at multiples of this as well, so fftw sees the same alignment everywhere
+    static constexpr size_t alignment = 64;
+    /// with LAA_HUGE_PAGES, arenas from this size on are aligned to and backed by huge pages
+    static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+    Arena() noexcept = default;
+    /**
+     * \brief Allocate an arena
+     * \param arenaBytes size
+     * \param zero zero the memory. Leave it if you overwrite all of it anyway
+     * \param hugePages ask for huge pages, if LAA_HUGE_PAGES is on and the arena is big enough.
+     * Faulting in huge pages costs more than it saves for an arena that is only written and read once
+     */
+    explicit Arena(size_t arenaBytes, bool zero = true, bool hugePages = true) noexcept;
+    ~Arena() noexcept;
+    /// deleted, copy the contents into a new arena instead
+    Arena(const Arena&) = delete;
+    /// deleted
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+
+    [[nodiscard]] std::byte* data() const noexcept;
+    [[nodiscard]] size_t size() const noexcept;
+    /// true if the os was asked for huge pages
+    [[nodiscard]] bool hugePages() const noexcept;
+
+    /**
+     * \brief Round a size up, so whatever comes after it is aligned
+     * \param size size in bytes
+     * \return next multiple of alignment
+     */
+    static constexpr size_t alignUp(size_t size) noexcept
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+private:
+    void release() noexcept;
+
+    std::byte* memory = nullptr;
+    size_t bytes = 0;
+    size_t memoryAlignment = alignment;
+    bool huge = false;
+};
+
+#endif //laa_arena_h
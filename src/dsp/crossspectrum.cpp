@@ -0,0 +1,169 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "crossspectrum.h"
+
+#include <algorithm>
+
+namespace {
+/// splitting bin loops smaller than this costs more than it brings
+constexpr size_t minBinsPerTask = 4096;
+
+/// what one bin of one frame adds to Gxx, Gyy and Gxy
+struct BinProducts {
+    Real xx;
+    Real yy;
+    Real xyRe;
+    Real xyIm;
+};
+
+BinProducts binProducts(const SplitSpan& input, const SplitSpan& reference, size_t i) noexcept
+{
+    const Real xRe = reference.re[i];
+    const Real xIm = reference.im[i];
+    const Real yRe = input.re[i];
+    const Real yIm = input.im[i];
+    // Gxy = conj(X) * Y
+    return { xRe * xRe + xIm * xIm, yRe * yRe + yIm * yIm, xRe * yRe + xIm * yIm, xRe * yIm - xIm * yRe };
+}
+}
+
+void CrossSpectrumAccumulator::configure(size_t bins, SpectrumAveraging mode, size_t frames) noexcept
+{
+    frames = std::clamp(frames, static_cast<size_t>(1), maxFrames);
+    if (bins == binCount && mode == averaging && frames == frameCount) {
+        return;
+    }
+
+    binCount = bins;
+    averaging = mode;
+    frameCount = frames;
+    gxx.assign(binCount, 0.0);
+    gyy.assign(binCount, 0.0);
+    gxy.re.assign(binCount, 0.0);
+    gxy.im.assign(binCount, 0.0);
+
+    // only frame averaging needs the history, and only as much as it uses
+    size_t historyCount = averaging == SpectrumAveraging::Frames ? frameCount : 0;
+    historyInput.resize(historyCount);
+    historyReference.resize(historyCount);
+    historyInput.shrink_to_fit();
+    historyReference.shrink_to_fit();
+    for (size_t i = 0; i < historyCount; i++) {
+        historyInput[i].resize(binCount);
+        historyReference[i].resize(binCount);
+    }
+
+    clear();
+}
+
+void CrossSpectrumAccumulator::clear() noexcept
+{
+    std::fill(gxx.begin(), gxx.end(), 0.0);
+    std::fill(gyy.begin(), gyy.end(), 0.0);
+    std::fill(gxy.re.begin(), gxy.re.end(), 0.0);
+    std::fill(gxy.im.begin(), gxy.im.end(), 0.0);
+    filled = 0;
+    writePos = 0;
+}
+
+void CrossSpectrumAccumulator::add(SplitSpan input, SplitSpan reference, TaskPool& pool) noexcept
+{
+    if (averaging != SpectrumAveraging::Frames) {
+        // exponential behaves like a plain mean until there are enough frames, so the start is not dominated by the first frame.
+        // infinite never stops being a plain mean
+        filled = averaging == SpectrumAveraging::Exponential ? std::min(filled + 1, frameCount) : filled + 1;
+        auto weight = static_cast<Real>(1.0 / static_cast<double>(filled));
+        pool.parallelFor(binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                auto products = binProducts(input, reference, i);
+                gxx[i] += weight * (products.xx - gxx[i]);
+                gyy[i] += weight * (products.yy - gyy[i]);
+                gxy.re[i] += weight * (products.xyRe - gxy.re[i]);
+                gxy.im[i] += weight * (products.xyIm - gxy.im[i]);
+            }
+        });
+        return;
+    }
+
+    // frame averaging: the oldest frame leaves the sums, the new one enters
+    bool full = filled == frameCount;
+    SplitSpan oldInput = historyInput[writePos];
+    SplitSpan oldReference = historyReference[writePos];
+    pool.parallelFor(binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (full) {
+                auto old = binProducts(oldInput, oldReference, i);
+                gxx[i] -= old.xx;
+                gyy[i] -= old.yy;
+                gxy.re[i] -= old.xyRe;
+                gxy.im[i] -= old.xyIm;
+            }
+            oldInput.re[i] = input.re[i];
+            oldInput.im[i] = input.im[i];
+            oldReference.re[i] = reference.re[i];
+            oldReference.im[i] = reference.im[i];
+            auto products = binProducts(input, reference, i);
+            gxx[i] += products.xx;
+            gyy[i] += products.yy;
+            gxy.re[i] += products.xyRe;
+            gxy.im[i] += products.xyIm;
+        }
+    });
+    filled = std::min(filled + 1, frameCount);
+    writePos = (writePos + 1) % frameCount;
+
+    // once per trip around the history. keeps the cost O(bins) per frame on average
+    if (full && writePos == 0) {
+        rebuild(pool);
+    }
+}
+
+void CrossSpectrumAccumulator::rebuild(TaskPool& pool) noexcept
+{
+    pool.parallelFor(binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            gxx[i] = 0.0;
+            gyy[i] = 0.0;
+            gxy.re[i] = 0.0;
+            gxy.im[i] = 0.0;
+            for (size_t frame = 0; frame < filled; frame++) {
+                auto products = binProducts(historyInput[frame], historyReference[frame], i);
+                gxx[i] += products.xx;
+                gyy[i] += products.yy;
+                gxy.re[i] += products.xyRe;
+                gxy.im[i] += products.xyIm;
+            }
+        }
+    });
+}
+
+void CrossSpectrumAccumulator::estimate(TransferEstimator estimator, ComplexSpan transferFunction, RealSpan coherence, RealSpan psdInput, RealSpan psdReference, ComplexSpan csd, TaskPool& pool) const noexcept
+{
+    // sums are turned into means. the ratios do not care, but the psds are shown as they are
+    auto scale = static_cast<Real>(averaging == SpectrumAveraging::Frames && filled > 0 ? 1.0 / static_cast<double>(filled) : 1.0);
+    pool.parallelFor(binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            psdReference[i] = gxx[i] * scale;
+            psdInput[i] = gyy[i] * scale;
+            csd[i] = gxy.at(i) * scale;
+            // H1 = Gxy / Gxx, H2 = Gyy / Gyx
+            transferFunction[i] = estimator == TransferEstimator::H1 ? csd[i] / psdReference[i] : psdInput[i] / conj(csd[i]);
+            coherence[i] = magSquared(csd[i]) / (psdReference[i] * psdInput[i]);
+        }
+    });
+}
@@ -0,0 +1,100 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_crossspectrum_h
+#define laa_crossspectrum_h
+
+#include "../audio/taskpool.h"
+#include "fft.h"
+#include "spectrumaverage.h"
+
+#include <vector>
+
+/**
+ * \brief Which transfer function estimate to derive
+ */
+enum class TransferEstimator {
+    /// Gxy / Gxx. Unbiased by noise on the input channel
+    H1,
+    /// Gyy / Gyx. Unbiased by noise on the reference channel
+    H2
+};
+
+/**
+ * \brief Keeps auto and cross spectra of reference (x) and input (y) averaged over frames
+ * Every frame costs a few multiply-adds per bin. The transfer function and the magnitude squared coherence
+ * fall out of the averaged spectra.
+ */
+class CrossSpectrumAccumulator {
+public:
+    /// frame averaging keeps this many frames around at most
+    static constexpr size_t maxFrames = 32;
+
+    /**
+     * \brief Set up the accumulator. Clears it if anything changed
+     * \param bins number of bins
+     * \param mode averaging mode
+     * \param frames number of frames to average over, or time constant in frames. Not used by SpectrumAveraging::Infinite
+     */
+    void configure(size_t bins, SpectrumAveraging mode, size_t frames) noexcept;
+
+    /**
+     * \brief Forget all frames
+     */
+    void clear() noexcept;
+
+    /**
+     * \brief Add a frame
+     * \param input input spectrum, y
+     * \param reference reference spectrum, x
+     * \param pool bins are split up over this pool
+     */
+    void add(SplitSpan input, SplitSpan reference, TaskPool& pool) noexcept;
+
+    /**
+     * \brief Derive everything from the averaged spectra
+     * \param estimator transfer function estimator to use
+     * \param transferFunction receives H
+     * \param coherence receives the magnitude squared coherence
+     * \param psdInput receives Gyy
+     * \param psdReference receives Gxx
+     * \param csd receives Gxy
+     * \param pool bins are split up over this pool
+     */
+    void estimate(TransferEstimator estimator, ComplexSpan transferFunction, RealSpan coherence, RealSpan psdInput, RealSpan psdReference, ComplexSpan csd, TaskPool& pool) const noexcept;
+
+private:
+    /// rebuild the sums from the history, so rounding errors do not pile up
+    void rebuild(TaskPool& pool) noexcept;
+
+    size_t binCount = 0;
+    SpectrumAveraging averaging = SpectrumAveraging::Frames;
+    size_t frameCount = 1;
+    /// frames added since the last clear. Stops at frameCount, except for SpectrumAveraging::Infinite
+    size_t filled = 0;
+    /// next history slot to write
+    size_t writePos = 0;
+    /// Gxx, Gyy and Gxy. sums for SpectrumAveraging::Frames, averages for the others
+    RealVec gxx = {};
+    RealVec gyy = {};
+    SplitSpectrum gxy = {};
+    /// the last frameCount frames, only for SpectrumAveraging::Frames
+    std::vector<SplitSpectrum> historyInput = {};
+    std::vector<SplitSpectrum> historyReference = {};
+};
+
+#endif //laa_crossspectrum_h
@@ -23,6 +23,170 @@
 #include <complex>
 #include <fftw3.h>
 // clang-format on
+#include "kernels.h"
+#include "span.h"
+
+/**
+ * \brief fftw for one precision
+ * fftw has a separate api for every precision: fftw_ for double and fftwf_ for float. This picks the one for T.
+ */
+template <class T>
+struct FftwApi;
+
+template <>
+struct FftwApi<double> {
+    using Plan = fftw_plan;
+
+    static void* malloc(size_t bytes) noexcept
+    {
+        return fftw_malloc(bytes);
+    }
+    static void free(void* data) noexcept
+    {
+        fftw_free(data);
+    }
+    static Plan planR2c(int n, double* in, std::complex<double>* out, unsigned flags) noexcept
+    {
+        return fftw_plan_dft_r2c_1d(n, in, reinterpret_cast<fftw_complex*>(out), flags);
+    }
+    static Plan planC2r(int n, std::complex<double>* in, double* out, unsigned flags) noexcept
+    {
+        return fftw_plan_dft_c2r_1d(n, reinterpret_cast<fftw_complex*>(in), out, flags);
+    }
+    static Plan planDft(int n, std::complex<double>* in, std::complex<double>* out, int sign, unsigned flags) noexcept
+    {
+        return fftw_plan_dft_1d(n, reinterpret_cast<fftw_complex*>(in), reinterpret_cast<fftw_complex*>(out), sign, flags);
+    }
+    static Plan planR2cSplit(int n, double* in, double* re, double* im, unsigned flags) noexcept
+    {
+        // one dimension, one transform. The guru interface is the only one with split output
+        fftw_iodim dim = { n, 1, 1 };
+        return fftw_plan_guru_split_dft_r2c(1, &dim, 0, nullptr, in, re, im, flags);
+    }
+    static void execute(Plan plan) noexcept
+    {
+        fftw_execute(plan);
+    }
+    static void executeDft(Plan plan, std::complex<double>* in, std::complex<double>* out) noexcept
+    {
+        fftw_execute_dft(plan, reinterpret_cast<fftw_complex*>(in), reinterpret_cast<fftw_complex*>(out));
+    }
+    static void executeR2c(Plan plan, double* in, std::complex<double>* out) noexcept
+    {
+        fftw_execute_dft_r2c(plan, in, reinterpret_cast<fftw_complex*>(out));
+    }
+    static void executeR2cSplit(Plan plan, double* in, double* re, double* im) noexcept
+    {
+        fftw_execute_split_dft_r2c(plan, in, re, im);
+    }
+    static void executeC2r(Plan plan, std::complex<double>* in, double* out) noexcept
+    {
+        fftw_execute_dft_c2r(plan, reinterpret_cast<fftw_complex*>(in), out);
+    }
+    static void destroyPlan(Plan plan) noexcept
+    {
+        fftw_destroy_plan(plan);
+    }
+    static int importWisdom(const char* path) noexcept
+    {
+        return fftw_import_wisdom_from_filename(path);
+    }
+    static int exportWisdom(const char* path) noexcept
+    {
+        return fftw_export_wisdom_to_filename(path);
+    }
+    static int initThreads() noexcept
+    {
+        return fftw_init_threads();
+    }
+    static void planWithThreads(int threads) noexcept
+    {
+        fftw_plan_with_nthreads(threads);
+    }
+};
+
+template <>
+struct FftwApi<float> {
+    using Plan = fftwf_plan;
+
+    static void* malloc(size_t bytes) noexcept
+    {
+        return fftwf_malloc(bytes);
+    }
+    static void free(void* data) noexcept
+    {
+        fftwf_free(data);
+    }
+    static Plan planR2c(int n, float* in, std::complex<float>* out, unsigned flags) noexcept
+    {
+        return fftwf_plan_dft_r2c_1d(n, in, reinterpret_cast<fftwf_complex*>(out), flags);
+    }
+    static Plan planC2r(int n, std::complex<float>* in, float* out, unsigned flags) noexcept
+    {
+        return fftwf_plan_dft_c2r_1d(n, reinterpret_cast<fftwf_complex*>(in), out, flags);
+    }
+    static Plan planDft(int n, std::complex<float>* in, std::complex<float>* out, int sign, unsigned flags) noexcept
+    {
+        return fftwf_plan_dft_1d(n, reinterpret_cast<fftwf_complex*>(in), reinterpret_cast<fftwf_complex*>(out), sign, flags);
+    }
+    static Plan planR2cSplit(int n, float* in, float* re, float* im, unsigned flags) noexcept
+    {
+        // one dimension, one transform. The guru interface is the only one with split output
+        fftwf_iodim dim = { n, 1, 1 };
+        return fftwf_plan_guru_split_dft_r2c(1, &dim, 0, nullptr, in, re, im, flags);
+    }
+    static void execute(Plan plan) noexcept
+    {
+        fftwf_execute(plan);
+    }
+    static void executeDft(Plan plan, std::complex<float>* in, std::complex<float>* out) noexcept
+    {
+        fftwf_execute_dft(plan, reinterpret_cast<fftwf_complex*>(in), reinterpret_cast<fftwf_complex*>(out));
+    }
+    static void executeR2c(Plan plan, float* in, std::complex<float>* out) noexcept
+    {
+        fftwf_execute_dft_r2c(plan, in, reinterpret_cast<fftwf_complex*>(out));
+    }
+    static void executeR2cSplit(Plan plan, float* in, float* re, float* im) noexcept
+    {
+        fftwf_execute_split_dft_r2c(plan, in, re, im);
+    }
+    static void executeC2r(Plan plan, std::complex<float>* in, float* out) noexcept
+    {
+        fftwf_execute_dft_c2r(plan, reinterpret_cast<fftwf_complex*>(in), out);
+    }
+    static void destroyPlan(Plan plan) noexcept
+    {
+        fftwf_destroy_plan(plan);
+    }
+    static int importWisdom(const char* path) noexcept
+    {
+        return fftwf_import_wisdom_from_filename(path);
+    }
+    static int exportWisdom(const char* path) noexcept
+    {
+        return fftwf_export_wisdom_to_filename(path);
+    }
+    static int initThreads() noexcept
+    {
+        return fftwf_init_threads();
+    }
+    static void planWithThreads(int threads) noexcept
+    {
+        fftwf_plan_with_nthreads(threads);
+    }
+};
+
+/// the precision samples and spectra are processed in. Set with the LAA_SINGLE_PRECISION cmake option
+#ifdef LAA_SINGLE_PRECISION
+using Real = float;
+#else
+using Real = double;
+#endif
+using Complex = std::complex<Real>;
+/// fftw in processing precision
+using Fftw = FftwApi<Real>;
+using FftwPlan = Fftw::Plan;
 
 template <class T>
 class FFTWAllocator : public std::allocator<T> {
@@ -33,43 +197,125 @@ public:
     };
     T* allocate(size_t n)
     {
-        return reinterpret_cast<T*>(fftw_malloc(sizeof(T) * n));
+        return reinterpret_cast<T*>(Fftw::malloc(sizeof(T) * n));
     }
     void deallocate(T* data, size_t)
     {
-        fftw_free(data);
+        Fftw::free(data);
     }
 };
 
-using Real = double;
 using RealVec = std::vector<Real, FFTWAllocator<Real>>;
-using Complex = std::complex<double>;
 using ComplexVec = std::vector<Complex, FFTWAllocator<Complex>>;
 
-inline double real(const Complex& c)
+/// views of arrays in processing precision, e.g. of a StateData or a RealVec
+using RealSpan = Span<Real>;
+using ConstRealSpan = Span<const Real>;
+using ComplexSpan = Span<Complex>;
+using ConstComplexSpan = Span<const Complex>;
+
+/**
+ * \brief A spectrum as one array of real and one of imaginary parts
+ * Loops over these vectorize without shuffling real and imaginary parts apart first.
+ */
+struct SplitSpectrum {
+    RealVec re = {};
+    RealVec im = {};
+
+    void resize(size_t bins)
+    {
+        re.resize(bins);
+        im.resize(bins);
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return re.size();
+    }
+
+    /// in reals
+    [[nodiscard]] size_t capacity() const noexcept
+    {
+        return re.capacity() + im.capacity();
+    }
+
+    [[nodiscard]] Complex at(size_t bin) const noexcept
+    {
+        return { re[bin], im[bin] };
+    }
+};
+
+/**
+ * \brief A SplitSpectrum that lives somewhere else, like in the arena of a StateData
+ */
+struct SplitSpan {
+    RealSpan re = {};
+    RealSpan im = {};
+
+    SplitSpan() noexcept = default;
+    SplitSpan(RealSpan realParts, RealSpan imagParts) noexcept
+        : re(realParts)
+        , im(imagParts)
+    {
+    }
+    SplitSpan(SplitSpectrum& spectrum) noexcept // NOLINT(google-explicit-constructor) stands in for the spectrum
+        : re(spectrum.re)
+        , im(spectrum.im)
+    {
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return re.size();
+    }
+
+    [[nodiscard]] Complex at(size_t bin) const noexcept
+    {
+        return { re[bin], im[bin] };
+    }
+};
+
+/// the spectral kernels in processing precision
+inline const SpectralKernelTable<Real>& kernels() noexcept
+{
+    return spectralKernels<Real>();
+}
+
+/// complex data as interleaved reals, the way the kernels take it
+inline Real* interleaved(Complex* c) noexcept
+{
+    return reinterpret_cast<Real*>(c); // NOLINT
+}
+
+inline const Real* interleaved(const Complex* c) noexcept
+{
+    return reinterpret_cast<const Real*>(c); // NOLINT
+}
+
+inline Real real(const Complex& c)
 {
     return c.real();
 }
 
-inline double imag(const Complex& c)
+inline Real imag(const Complex& c)
 {
     return c.imag();
 }
 
-inline double phase(const Complex& c)
+inline Real phase(const Complex& c)
 {
     return std::arg(c);
 }
 
-inline double mag(const Complex& c)
+inline Real mag(const Complex& c)
 {
     return std::abs(c);
 }
 
-inline double magSquared(const Complex& c)
+inline Real magSquared(const Complex& c)
 {
-    double real = c.real();
-    double imag = c.imag();
+    Real real = c.real();
+    Real imag = c.imag();
 
     return real * real + imag * imag;
 }
@@ -0,0 +1,142 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fftplan.h"
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+namespace {
+// the fftw planner is not thread safe, but plans are made and destroyed on several threads
+std::mutex plannerLock;
+// threads for ffts of at least LAA_THREADED_FFT_LENGTH. 1 until initThreads
+int fftThreads = 1;
+}
+
+void FftPlan::initThreads(size_t threads) noexcept
+{
+    std::lock_guard<std::mutex> lock(plannerLock);
+    if (Fftw::initThreads() != 0) {
+        fftThreads = static_cast<int>(std::max(threads, static_cast<size_t>(1)));
+    }
+}
+
+void FftPlan::loadWisdom(const std::string& path) noexcept
+{
+    std::lock_guard<std::mutex> lock(plannerLock);
+    Fftw::importWisdom(path.c_str());
+}
+
+void FftPlan::saveWisdom(const std::string& path) noexcept
+{
+    std::lock_guard<std::mutex> lock(plannerLock);
+    Fftw::exportWisdom(path.c_str());
+}
+
+std::shared_ptr<const FftPlan> FftPlan::get(size_t length, FftDirection direction) noexcept
+{
+    static std::mutex cacheLock;
+    static std::map<std::pair<size_t, FftDirection>, std::weak_ptr<const FftPlan>> cache;
+
+    // planning happens under the cache lock, so two threads asking for the same plan only plan once.
+    // the states hold their plans, so the plans of a dropped pool go away with it. Planning them again is quick, thanks to wisdom.
+    std::lock_guard<std::mutex> lock(cacheLock);
+    for (auto iter = cache.begin(); iter != cache.end();) {
+        iter = iter->second.expired() ? cache.erase(iter) : std::next(iter);
+    }
+    auto& entry = cache[{ length, direction }];
+    auto plan = entry.lock();
+    if (plan == nullptr) {
+        plan = std::make_shared<const FftPlan>(length, direction);
+        entry = plan;
+    }
+    return plan;
+}
+
+FftPlan::FftPlan(size_t length, FftDirection direction) noexcept
+{
+    // plans are made on scratch buffers. measuring scribbles all over them
+    RealVec samples(direction == FftDirection::ComplexForward ? 0 : length);
+    ComplexVec bins;
+    // both parts in one buffer, as far apart as they are in every output
+    RealVec splitBins;
+    if (direction == FftDirection::ComplexForward) {
+        bins.resize(length);
+    } else if (direction == FftDirection::ForwardSplit) {
+        imagOffset = splitImagOffset(length);
+        splitBins.resize(2 * imagOffset);
+    } else {
+        bins.resize(length / 2 + 1);
+    }
+
+    // the long ones are made while the user waits. Wisdom still helps them.
+    unsigned flags = length > LAA_MAX_MEASURED_FFT_LENGTH ? FFTW_ESTIMATE : FFTW_MEASURE;
+    std::lock_guard<std::mutex> lock(plannerLock);
+    Fftw::planWithThreads(length >= LAA_THREADED_FFT_LENGTH ? fftThreads : 1);
+    switch (direction) {
+    case FftDirection::Forward:
+        plan = Fftw::planR2c(static_cast<int>(length), samples.data(), bins.data(), flags);
+        break;
+    case FftDirection::Backward:
+        plan = Fftw::planC2r(static_cast<int>(length), bins.data(), samples.data(), flags | FFTW_PRESERVE_INPUT);
+        break;
+    case FftDirection::ComplexForward:
+        plan = Fftw::planDft(static_cast<int>(length), bins.data(), bins.data(), FFTW_FORWARD, flags);
+        break;
+    case FftDirection::ForwardSplit:
+        plan = Fftw::planR2cSplit(static_cast<int>(length), samples.data(), splitBins.data(), splitBins.data() + imagOffset, flags);
+        break;
+    }
+}
+
+FftPlan::~FftPlan() noexcept
+{
+    std::lock_guard<std::mutex> lock(plannerLock);
+    Fftw::destroyPlan(plan);
+}
+
+void FftPlan::execute(RealSpan in, ComplexSpan out) const noexcept
+{
+    Fftw::executeR2c(plan, in.data(), out.data());
+}
+
+size_t FftPlan::splitImagOffset(size_t length) noexcept
+{
+    return Arena::alignUp((length / 2 + 1) * sizeof(Real)) / sizeof(Real);
+}
+
+void FftPlan::execute(RealSpan in, SplitSpan out) const noexcept
+{
+    // the imaginary parts would end up imagOffset reals after the real ones, whatever memory that is
+    if (out.im.data() != out.re.data() + imagOffset) { // NOLINT
+        std::abort();
+    }
+    Fftw::executeR2cSplit(plan, in.data(), out.re.data(), out.im.data());
+}
+
+void FftPlan::execute(ComplexSpan in, RealSpan out) const noexcept
+{
+    Fftw::executeC2r(plan, in.data(), out.data());
+}
+
+void FftPlan::execute(ComplexSpan inOut) const noexcept
+{
+    Fftw::executeDft(plan, inOut.data(), inOut.data());
+}
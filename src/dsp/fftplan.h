@@ -0,0 +1,141 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_fftplan_h
+#define laa_fftplan_h
+
+#include "fft.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/// plans up to this length are measured. Measuring the longer ones takes seconds, so they are estimated
+static constexpr size_t LAA_MAX_MEASURED_FFT_LENGTH = 131072;
+/// from this length on, the ffts are spread over several threads
+static constexpr size_t LAA_THREADED_FFT_LENGTH = 262144;
+
+/**
+ * \brief Which way an FftPlan goes
+ */
+enum class FftDirection {
+    /// real samples to fftLen / 2 + 1 bins
+    Forward,
+    /// fftLen / 2 + 1 bins to real samples
+    Backward,
+    /// complex samples to fftLen complex bins, in place
+    ComplexForward,
+    /// real samples to fftLen / 2 + 1 bins, split into real and imaginary parts. \sa FftPlan::splitImagOffset
+    ForwardSplit
+};
+
+/**
+ * \brief A real fft plan, shared by everyone who needs that length and direction
+ * Plans do not hold on to buffers. They run on whatever buffers they are given, as long as these are aligned
+ * like the fftw allocator does it. Running one plan on several threads at once is fine.
+ */
+class FftPlan {
+public:
+    /**
+     * \brief Let fftw spread long ffts over threads. Call once, before the first plan is made
+     * \param threads threads a single fft may use
+     */
+    static void initThreads(size_t threads) noexcept;
+
+    /**
+     * \brief Load fftw wisdom from a file
+     * \param path the file
+     */
+    static void loadWisdom(const std::string& path) noexcept;
+
+    /**
+     * \brief Save what fftw learned while planning to a file
+     * \param path the file
+     */
+    static void saveWisdom(const std::string& path) noexcept;
+
+    /**
+     * \brief Get the shared plan for a length and direction. Plans it if there is none yet
+     * The cache does not keep plans alive, so hold on to it as long as you use it.
+     * \note Locks a cache and might take a while. Do not call from the audio callback
+     * \param length fft length
+     * \param direction direction
+     * \return the plan
+     */
+    static std::shared_ptr<const FftPlan> get(size_t length, FftDirection direction) noexcept;
+
+    /**
+     * \brief ctor. Use \sa get instead
+     * \param length fft length
+     * \param direction direction
+     */
+    FftPlan(size_t length, FftDirection direction) noexcept;
+    /// dtor
+    ~FftPlan() noexcept;
+    /// deleted
+    FftPlan(const FftPlan&) = delete;
+    /// deleted
+    FftPlan(FftPlan&&) = delete;
+    /// deleted
+    FftPlan& operator=(const FftPlan&) = delete;
+    /// deleted
+    FftPlan& operator=(FftPlan&&) = delete;
+
+    /**
+     * \brief Run a FftDirection::Forward plan
+     * \param in length samples. Left as they are
+     * \param out receives length / 2 + 1 bins
+     */
+    void execute(RealSpan in, ComplexSpan out) const noexcept;
+
+    /**
+     * \brief Where the imaginary parts of a FftDirection::ForwardSplit plan go
+     * fftw bakes the distance between real and imaginary parts into the plan, so every output needs the same one.
+     * It is that of two arrays of length / 2 + 1 bins one after the other, each aligned like an Arena does it.
+     * \param length fft length
+     * \return offset of the imaginary parts from the real ones, in reals
+     */
+    static size_t splitImagOffset(size_t length) noexcept;
+
+    /**
+     * \brief Run a FftDirection::ForwardSplit plan
+     * \note Aborts if out.im does not start splitImagOffset reals after out.re. fftw would write it somewhere else
+     * \param in length samples. Left as they are
+     * \param out receives length / 2 + 1 bins
+     */
+    void execute(RealSpan in, SplitSpan out) const noexcept;
+
+    /**
+     * \brief Run a FftDirection::Backward plan
+     * \param in length / 2 + 1 bins. Left as they are
+     * \param out receives length samples
+     */
+    void execute(ComplexSpan in, RealSpan out) const noexcept;
+
+    /**
+     * \brief Run a FftDirection::ComplexForward plan
+     * \param inOut length samples. Receives length bins
+     */
+    void execute(ComplexSpan inOut) const noexcept;
+
+private:
+    FftwPlan plan = {};
+    /// splitImagOffset of the length, for FftDirection::ForwardSplit
+    size_t imagOffset = 0;
+};
+
+#endif //laa_fftplan_h
@@ -0,0 +1,344 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#ifdef LAA_X86_KERNELS
+#ifdef _MSC_VER
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+template <class T>
+const std::complex<T>* asComplex(const T* data) noexcept
+{
+    return reinterpret_cast<const std::complex<T>*>(data); // NOLINT
+}
+
+template <class T>
+std::complex<T>* asComplex(T* data) noexcept
+{
+    return reinterpret_cast<std::complex<T>*>(data); // NOLINT
+}
+
+template <class T>
+void scalarScale(T* data, size_t count, T factor) noexcept
+{
+    for (size_t i = 0; i < count; i++) {
+        data[i] *= factor; // NOLINT
+    }
+}
+
+template <class T>
+void scalarMultiply(T* out, const T* a, const T* b, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i++) {
+        out[i] = a[i] * b[i]; // NOLINT
+    }
+}
+
+template <class T>
+void scalarMagnitude(T* out, const T* in, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i++) {
+        out[i] = std::abs(asComplex(in)[i]); // NOLINT
+    }
+}
+
+template <class T>
+void scalarMagnitudeSplit(T* out, const T* re, const T* im, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i++) {
+        out[i] = std::abs(std::complex<T>(re[i], im[i])); // NOLINT
+    }
+}
+
+template <class T>
+void scalarMagnitudeSquared(T* out, const T* in, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i++) {
+        out[i] = std::norm(asComplex(in)[i]); // NOLINT
+    }
+}
+
+template <class T>
+void scalarPhase(T* out, const T* in, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i++) {
+        out[i] = std::arg(asComplex(in)[i]); // NOLINT
+    }
+}
+
+template <class T>
+void scalarDivide(T* out, const T* num, const T* den, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i++) {
+        asComplex(out)[i] = asComplex(num)[i] / asComplex(den)[i]; // NOLINT
+    }
+}
+
+template <class T>
+void scalarDivideSplit(T* out, const T* numRe, const T* numIm, const T* denRe, const T* denIm, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i++) {
+        asComplex(out)[i] = std::complex<T>(numRe[i], numIm[i]) / std::complex<T>(denRe[i], denIm[i]); // NOLINT
+    }
+}
+
+#ifdef LAA_X86_KERNELS
+enum class CpuFeature {
+    Sse2,
+    /// avx2 and fma
+    Avx2,
+    Avx512
+};
+
+/// check if the cpu has an instruction set, and the os saves its registers
+bool cpuHas(CpuFeature feature) noexcept
+{
+#ifdef _MSC_VER
+    constexpr int eax = 0;
+    constexpr int ebx = 1;
+    constexpr int ecx = 2;
+    constexpr int edx = 3;
+    int regs[4] = {}; // NOLINT
+    __cpuid(regs, 0);
+    const int maxLeaf = regs[eax];
+    __cpuid(regs, 1);
+    const bool sse2 = (regs[edx] & (1 << 26)) != 0;
+    const bool fma = (regs[ecx] & (1 << 12)) != 0;
+    const bool osxsave = (regs[ecx] & (1 << 27)) != 0;
+    // the os has to save the ymm (and zmm) registers on a task switch, or using them is not safe
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    const bool avxState = (xcr0 & 0x6) == 0x6;
+    const bool avx512State = (xcr0 & 0xe6) == 0xe6;
+    bool avx2 = false;
+    bool avx512f = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(regs, 7, 0);
+        avx2 = (regs[ebx] & (1 << 5)) != 0;
+        avx512f = (regs[ebx] & (1 << 16)) != 0;
+    }
+    switch (feature) {
+    case CpuFeature::Sse2:
+        return sse2;
+    case CpuFeature::Avx2:
+        return avx2 && fma && avxState;
+    case CpuFeature::Avx512:
+        return avx512f && avx512State;
+    }
+#else
+    // these also check that the os saves the registers
+    __builtin_cpu_init();
+    switch (feature) {
+    case CpuFeature::Sse2:
+        return __builtin_cpu_supports("sse2");
+    case CpuFeature::Avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case CpuFeature::Avx512:
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+
+    return false;
+}
+#endif
+
+template <class T>
+bool close(T value, T expected, T tolerance) noexcept
+{
+    return std::abs(value - expected) <= tolerance * std::max(T(1.0), std::abs(expected));
+}
+
+/**
+ * \brief Run every kernel of a table on a test spectrum and compare to the scalar ones
+ * The length is odd, so the tail handling is checked as well. The spectrum starts with the cases phase has to get
+ * right: zeros, both axes and both signs of zero. arg(-0 + 0i) is pi, we give 0 there, which is not worth a branch.
+ */
+template <class T>
+bool matchesScalar(const SpectralKernelTable<T>& kernels) noexcept
+{
+    constexpr size_t count = 1031;
+    const auto& reference = scalarKernels<T>();
+    const T epsilon = std::numeric_limits<T>::epsilon();
+
+    std::vector<T> a(2 * count);
+    std::vector<T> b(2 * count);
+    std::minstd_rand random(1234);
+    std::uniform_real_distribution<T> values(T(-10.0), T(10.0));
+    for (size_t i = 0; i < 2 * count; i++) {
+        a[i] = values(random);
+        b[i] = values(random);
+    }
+    const std::complex<T> specials[] = { { T(0.0), T(0.0) }, { T(0.0), T(-0.0) }, { T(0.0), T(1.0) }, { T(0.0), T(-1.0) }, // NOLINT
+        { T(-0.0), T(1.0) }, { T(-0.0), T(-1.0) }, { T(1.0), T(0.0) }, { T(1.0), T(-0.0) }, { T(-1.0), T(0.0) },
+        { T(-1.0), T(-0.0) }, { T(1.0), T(1.0) }, { T(-1.0), T(-1.0) } };
+    size_t pos = 0;
+    for (const auto& special : specials) {
+        a[2 * pos] = special.real();
+        a[2 * pos + 1] = special.imag();
+        pos++;
+    }
+
+    std::vector<T> expected(2 * count);
+    std::vector<T> result(2 * count);
+    auto compare = [&](size_t n, T tolerance) {
+        for (size_t i = 0; i < n; i++) {
+            if (!close(result[i], expected[i], tolerance)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    expected = a;
+    result = a;
+    reference.scale(expected.data(), 2 * count, T(0.125));
+    kernels.scale(result.data(), 2 * count, T(0.125));
+    if (!compare(2 * count, epsilon)) {
+        return false;
+    }
+
+    reference.multiply(expected.data(), a.data(), b.data(), 2 * count);
+    kernels.multiply(result.data(), a.data(), b.data(), 2 * count);
+    if (!compare(2 * count, epsilon)) {
+        return false;
+    }
+
+    reference.magnitude(expected.data(), a.data(), count);
+    kernels.magnitude(result.data(), a.data(), count);
+    if (!compare(count, 4 * epsilon)) {
+        return false;
+    }
+
+    // a and b as the real and imaginary parts
+    reference.magnitudeSplit(expected.data(), a.data(), b.data(), count);
+    kernels.magnitudeSplit(result.data(), a.data(), b.data(), count);
+    if (!compare(count, 4 * epsilon)) {
+        return false;
+    }
+
+    reference.magnitudeSquared(expected.data(), a.data(), count);
+    kernels.magnitudeSquared(result.data(), a.data(), count);
+    if (!compare(count, 4 * epsilon)) {
+        return false;
+    }
+
+    // the phase is an approximation, and absolute error is what counts for an angle
+    reference.phase(expected.data(), a.data(), count);
+    kernels.phase(result.data(), a.data(), count);
+    for (size_t i = 0; i < count; i++) {
+        if (std::abs(result[i] - expected[i]) > T(2e-6)) {
+            return false;
+        }
+    }
+
+    // skip the zeros up front, we do not handle them like std::complex does.
+    // the error of a quotient is relative to the whole quotient, not to its parts
+    reference.divide(expected.data(), b.data(), a.data() + 2 * pos, count - pos);
+    kernels.divide(result.data(), b.data(), a.data() + 2 * pos, count - pos);
+    auto compareComplex = [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            auto expectedValue = asComplex(expected.data())[i];
+            if (std::abs(asComplex(result.data())[i] - expectedValue) > 8 * epsilon * std::max(T(1.0), std::abs(expectedValue))) {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!compareComplex(count - pos)) {
+        return false;
+    }
+
+    // the halves of b over the halves of a, as real and imaginary parts
+    const size_t half = count - pos;
+    const T* denominator = a.data() + 2 * pos;
+    reference.divideSplit(expected.data(), b.data(), b.data() + half, denominator, denominator + half, half);
+    kernels.divideSplit(result.data(), b.data(), b.data() + half, denominator, denominator + half, half);
+    return compareComplex(half);
+}
+
+template <class T>
+const SpectralKernelTable<T>& pickKernels() noexcept
+{
+    // fastest last
+    const SpectralKernelTable<T>* tables[maxKernelVariants] = {}; // NOLINT
+    size_t count = runnableKernels(tables);
+    for (size_t i = count; i > 1; i--) {
+        const auto& candidate = *tables[i - 1]; // NOLINT
+        if (matchesScalar(candidate)) {
+            return candidate;
+        }
+        // a broken build would only show up as a slowdown otherwise. tests/kernelstest catches it before it ships
+        std::cerr << "LAA: " << candidate.name << " kernels do not match the scalar ones, not using them\n";
+    }
+    return scalarKernels<T>();
+}
+
+}
+
+template <class T>
+const SpectralKernelTable<T>& scalarKernels() noexcept
+{
+    static const SpectralKernelTable<T> kernels = { "Scalar", &scalarScale<T>, &scalarMultiply<T>, &scalarMagnitude<T>,
+        &scalarMagnitudeSplit<T>, &scalarMagnitudeSquared<T>, &scalarPhase<T>, &scalarDivide<T>, &scalarDivideSplit<T> };
+    return kernels;
+}
+
+template <class T>
+size_t runnableKernels(const SpectralKernelTable<T>* (&tables)[maxKernelVariants]) noexcept
+{
+    size_t count = 0;
+    tables[count++] = &scalarKernels<T>();
+#ifdef LAA_X86_KERNELS
+    if (cpuHas(CpuFeature::Sse2)) {
+        tables[count++] = &sse2Kernels<T>();
+    }
+    if (cpuHas(CpuFeature::Avx2)) {
+        tables[count++] = &avx2Kernels<T>();
+    }
+    if (cpuHas(CpuFeature::Avx512)) {
+        tables[count++] = &avx512Kernels<T>();
+    }
+#endif
+    return count;
+}
+
+template <class T>
+const SpectralKernelTable<T>& spectralKernels() noexcept
+{
+    static const SpectralKernelTable<T>& kernels = pickKernels<T>();
+    return kernels;
+}
+
+template const SpectralKernelTable<double>& scalarKernels<double>() noexcept;
+template const SpectralKernelTable<float>& scalarKernels<float>() noexcept;
+template size_t runnableKernels<double>(const SpectralKernelTable<double>* (&tables)[maxKernelVariants]) noexcept;
+template size_t runnableKernels<float>(const SpectralKernelTable<float>* (&tables)[maxKernelVariants]) noexcept;
+template const SpectralKernelTable<double>& spectralKernels<double>() noexcept;
+template const SpectralKernelTable<float>& spectralKernels<float>() noexcept;
@@ -0,0 +1,90 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_kernels_h
+#define laa_kernels_h
+
+#include <cstddef>
+
+// this header is also included by the per instruction set files, so it must not have any inline functions.
+// Those would be built with avx there, and the linker may pick that copy for everyone.
+
+/**
+ * \brief The per bin loops over spectra, for one precision and one instruction set
+ * Complex data is interleaved (re, im, re, im, ...), the way std::complex and fftw lay it out.
+ * Counts are in elements of the output: bins for complex data, values for real data.
+ * \tparam T float or double
+ */
+template <class T>
+struct SpectralKernelTable {
+    /// name of the instruction set, for display
+    const char* name;
+    /// data[i] *= factor
+    void (*scale)(T* data, size_t count, T factor) noexcept;
+    /// out[i] = a[i] * b[i]. out may be a or b
+    void (*multiply)(T* out, const T* a, const T* b, size_t count) noexcept;
+    /// out[i] = |in[i]|. in is complex
+    void (*magnitude)(T* out, const T* in, size_t count) noexcept;
+    /// out[i] = |re[i] + i im[i]|
+    void (*magnitudeSplit)(T* out, const T* re, const T* im, size_t count) noexcept;
+    /// out[i] = |in[i]|^2. in is complex
+    void (*magnitudeSquared)(T* out, const T* in, size_t count) noexcept;
+    /// out[i] = arg(in[i]). in is complex. Accurate to about 1e-6 rad, which is plenty for anything we draw
+    void (*phase)(T* out, const T* in, size_t count) noexcept;
+    /// out[i] = num[i] / den[i], all complex. out may be num or den. Skips the inf and nan special cases std::complex has
+    void (*divide)(T* out, const T* num, const T* den, size_t count) noexcept;
+    /// out[i] = (numRe[i] + i numIm[i]) / (denRe[i] + i denIm[i]). out is complex, like divide
+    void (*divideSplit)(T* out, const T* numRe, const T* numIm, const T* denRe, const T* denIm, size_t count) noexcept;
+};
+
+/// plain c++, the reference the others are checked against
+template <class T>
+const SpectralKernelTable<T>& scalarKernels() noexcept;
+
+#ifdef LAA_X86_KERNELS
+/// kernels_sse2.cpp
+template <class T>
+const SpectralKernelTable<T>& sse2Kernels() noexcept;
+/// kernels_avx2.cpp. Needs avx2 and fma
+template <class T>
+const SpectralKernelTable<T>& avx2Kernels() noexcept;
+/// kernels_avx512.cpp. Needs avx512f
+template <class T>
+const SpectralKernelTable<T>& avx512Kernels() noexcept;
+#endif
+
+/// number of kernel variants there can be, scalar included
+constexpr size_t maxKernelVariants = 4;
+
+/**
+ * \brief Every variant this cpu can run, whether it gives the same results as the scalar kernels or not. For the tests
+ * \param tables receives the variants, scalar first
+ * \return number of variants written to tables
+ */
+template <class T>
+size_t runnableKernels(const SpectralKernelTable<T>* (&tables)[maxKernelVariants]) noexcept;
+
+/**
+ * \brief The fastest kernels this cpu runs, in processing precision
+ * Picked on first use from cpuid. A variant is only used if it gives the same results as the scalar kernels on a
+ * test spectrum, so a broken build falls back instead of drawing garbage. The fallback is reported on stderr.
+ * \return kernel table. Lives forever
+ */
+template <class T>
+const SpectralKernelTable<T>& spectralKernels() noexcept;
+
+#endif //laa_kernels_h
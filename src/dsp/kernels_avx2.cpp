@@ -0,0 +1,115 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// built with avx2 and fma, and only called if the cpu has both.
+// Do not include anything from the standard library here, see kernels_impl.h
+
+#include "kernels_impl.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Double {
+    using Real = double;
+    using Vec = __m256d;
+    using Mask = __m256d;
+    static constexpr size_t width = 4;
+
+    static Vec load(const double* src) noexcept { return _mm256_loadu_pd(src); }
+    static void store(double* dst, Vec v) noexcept { _mm256_storeu_pd(dst, v); }
+    static Vec set1(double v) noexcept { return _mm256_set1_pd(v); }
+    static Vec add(Vec a, Vec b) noexcept { return _mm256_add_pd(a, b); }
+    static Vec sub(Vec a, Vec b) noexcept { return _mm256_sub_pd(a, b); }
+    static Vec mul(Vec a, Vec b) noexcept { return _mm256_mul_pd(a, b); }
+    static Vec div(Vec a, Vec b) noexcept { return _mm256_div_pd(a, b); }
+    static Vec sqrt(Vec a) noexcept { return _mm256_sqrt_pd(a); }
+    static Vec min(Vec a, Vec b) noexcept { return _mm256_min_pd(a, b); }
+    static Vec max(Vec a, Vec b) noexcept { return _mm256_max_pd(a, b); }
+    static Vec abs(Vec a) noexcept { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static Vec signBit(Vec a) noexcept { return _mm256_and_pd(_mm256_set1_pd(-0.0), a); }
+    static Vec orBits(Vec a, Vec b) noexcept { return _mm256_or_pd(a, b); }
+    static Mask greater(Vec a, Vec b) noexcept { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static Vec select(Mask m, Vec a, Vec b) noexcept { return _mm256_blendv_pd(b, a, m); }
+    static void split(Vec a, Vec b, Vec& re, Vec& im) noexcept
+    {
+        // unpack works within 128 bit lanes and leaves bins 0 2 1 3. Swapping the middle puts them back in order
+        re = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        im = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+    }
+    static void join(Vec re, Vec im, Vec& a, Vec& b) noexcept
+    {
+        re = _mm256_permute4x64_pd(re, _MM_SHUFFLE(3, 1, 2, 0));
+        im = _mm256_permute4x64_pd(im, _MM_SHUFFLE(3, 1, 2, 0));
+        a = _mm256_unpacklo_pd(re, im);
+        b = _mm256_unpackhi_pd(re, im);
+    }
+};
+
+struct Avx2Float {
+    using Real = float;
+    using Vec = __m256;
+    using Mask = __m256;
+    static constexpr size_t width = 8;
+
+    static Vec load(const float* src) noexcept { return _mm256_loadu_ps(src); }
+    static void store(float* dst, Vec v) noexcept { _mm256_storeu_ps(dst, v); }
+    static Vec set1(float v) noexcept { return _mm256_set1_ps(v); }
+    static Vec add(Vec a, Vec b) noexcept { return _mm256_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b) noexcept { return _mm256_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) noexcept { return _mm256_mul_ps(a, b); }
+    static Vec div(Vec a, Vec b) noexcept { return _mm256_div_ps(a, b); }
+    static Vec sqrt(Vec a) noexcept { return _mm256_sqrt_ps(a); }
+    static Vec min(Vec a, Vec b) noexcept { return _mm256_min_ps(a, b); }
+    static Vec max(Vec a, Vec b) noexcept { return _mm256_max_ps(a, b); }
+    static Vec abs(Vec a) noexcept { return _mm256_andnot_ps(_mm256_set1_ps(-0.0F), a); }
+    static Vec signBit(Vec a) noexcept { return _mm256_and_ps(_mm256_set1_ps(-0.0F), a); }
+    static Vec orBits(Vec a, Vec b) noexcept { return _mm256_or_ps(a, b); }
+    static Mask greater(Vec a, Vec b) noexcept { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Vec select(Mask m, Vec a, Vec b) noexcept { return _mm256_blendv_ps(b, a, m); }
+    static Vec swapMiddle(Vec v) noexcept
+    {
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    static void split(Vec a, Vec b, Vec& re, Vec& im) noexcept
+    {
+        // shuffle works within 128 bit lanes and leaves pairs of bins in the order 0 2 1 3
+        re = swapMiddle(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        im = swapMiddle(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    static void join(Vec re, Vec im, Vec& a, Vec& b) noexcept
+    {
+        re = swapMiddle(re);
+        im = swapMiddle(im);
+        a = _mm256_unpacklo_ps(re, im);
+        b = _mm256_unpackhi_ps(re, im);
+    }
+};
+
+} // namespace
+
+template <>
+const SpectralKernelTable<double>& avx2Kernels<double>() noexcept
+{
+    return KernelImpl<Avx2Double>::table("AVX2");
+}
+
+template <>
+const SpectralKernelTable<float>& avx2Kernels<float>() noexcept
+{
+    return KernelImpl<Avx2Float>::table("AVX2");
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// built with avx512f, and only called if the cpu and the os support it.
+// Do not include anything from the standard library here, see kernels_impl.h
+
+#include "kernels_impl.h"
+
+#if defined(__GNUC__) && !defined(__clang__)
+// gcc warns about the undefined vectors its own avx512 intrinsics start out from
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512Double {
+    using Real = double;
+    using Vec = __m512d;
+    using Mask = __mmask8;
+    static constexpr size_t width = 8;
+
+    static Vec load(const double* src) noexcept { return _mm512_loadu_pd(src); }
+    static void store(double* dst, Vec v) noexcept { _mm512_storeu_pd(dst, v); }
+    static Vec set1(double v) noexcept { return _mm512_set1_pd(v); }
+    static Vec add(Vec a, Vec b) noexcept { return _mm512_add_pd(a, b); }
+    static Vec sub(Vec a, Vec b) noexcept { return _mm512_sub_pd(a, b); }
+    static Vec mul(Vec a, Vec b) noexcept { return _mm512_mul_pd(a, b); }
+    static Vec div(Vec a, Vec b) noexcept { return _mm512_div_pd(a, b); }
+    static Vec sqrt(Vec a) noexcept { return _mm512_sqrt_pd(a); }
+    static Vec min(Vec a, Vec b) noexcept { return _mm512_min_pd(a, b); }
+    static Vec max(Vec a, Vec b) noexcept { return _mm512_max_pd(a, b); }
+    // the floating point and/or are avx512dq, the integer ones are in avx512f
+    static Vec abs(Vec a) noexcept { return _mm512_castsi512_pd(_mm512_andnot_si512(_mm512_castpd_si512(_mm512_set1_pd(-0.0)), _mm512_castpd_si512(a))); }
+    static Vec signBit(Vec a) noexcept { return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(_mm512_set1_pd(-0.0)), _mm512_castpd_si512(a))); }
+    static Vec orBits(Vec a, Vec b) noexcept { return _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(b))); }
+    static Mask greater(Vec a, Vec b) noexcept { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static Vec select(Mask m, Vec a, Vec b) noexcept { return _mm512_mask_blend_pd(m, b, a); }
+    static void split(Vec a, Vec b, Vec& re, Vec& im) noexcept
+    {
+        // unpack works within 128 bit lanes and leaves bins 0 4 1 5 2 6 3 7
+        const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+        re = _mm512_permutexvar_pd(order, _mm512_unpacklo_pd(a, b));
+        im = _mm512_permutexvar_pd(order, _mm512_unpackhi_pd(a, b));
+    }
+    static void join(Vec re, Vec im, Vec& a, Vec& b) noexcept
+    {
+        const __m512i order = _mm512_setr_epi64(0, 4, 1, 5, 2, 6, 3, 7);
+        re = _mm512_permutexvar_pd(order, re);
+        im = _mm512_permutexvar_pd(order, im);
+        a = _mm512_unpacklo_pd(re, im);
+        b = _mm512_unpackhi_pd(re, im);
+    }
+};
+
+struct Avx512Float {
+    using Real = float;
+    using Vec = __m512;
+    using Mask = __mmask16;
+    static constexpr size_t width = 16;
+
+    static Vec load(const float* src) noexcept { return _mm512_loadu_ps(src); }
+    static void store(float* dst, Vec v) noexcept { _mm512_storeu_ps(dst, v); }
+    static Vec set1(float v) noexcept { return _mm512_set1_ps(v); }
+    static Vec add(Vec a, Vec b) noexcept { return _mm512_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b) noexcept { return _mm512_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) noexcept { return _mm512_mul_ps(a, b); }
+    static Vec div(Vec a, Vec b) noexcept { return _mm512_div_ps(a, b); }
+    static Vec sqrt(Vec a) noexcept { return _mm512_sqrt_ps(a); }
+    static Vec min(Vec a, Vec b) noexcept { return _mm512_min_ps(a, b); }
+    static Vec max(Vec a, Vec b) noexcept { return _mm512_max_ps(a, b); }
+    static Vec abs(Vec a) noexcept { return _mm512_castsi512_ps(_mm512_andnot_si512(_mm512_castps_si512(_mm512_set1_ps(-0.0F)), _mm512_castps_si512(a))); }
+    static Vec signBit(Vec a) noexcept { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(_mm512_set1_ps(-0.0F)), _mm512_castps_si512(a))); }
+    static Vec orBits(Vec a, Vec b) noexcept { return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+    static Mask greater(Vec a, Vec b) noexcept { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static Vec select(Mask m, Vec a, Vec b) noexcept { return _mm512_mask_blend_ps(m, b, a); }
+    static void split(Vec a, Vec b, Vec& re, Vec& im) noexcept
+    {
+        // shuffle works within 128 bit lanes and leaves pairs of bins in the order 0 4 1 5 2 6 3 7
+        const __m512i order = _mm512_setr_epi32(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+        re = _mm512_permutexvar_ps(order, _mm512_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        im = _mm512_permutexvar_ps(order, _mm512_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    static void join(Vec re, Vec im, Vec& a, Vec& b) noexcept
+    {
+        const __m512i order = _mm512_setr_epi32(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+        re = _mm512_permutexvar_ps(order, re);
+        im = _mm512_permutexvar_ps(order, im);
+        a = _mm512_unpacklo_ps(re, im);
+        b = _mm512_unpackhi_ps(re, im);
+    }
+};
+
+} // namespace
+
+template <>
+const SpectralKernelTable<double>& avx512Kernels<double>() noexcept
+{
+    return KernelImpl<Avx512Double>::table("AVX-512");
+}
+
+template <>
+const SpectralKernelTable<float>& avx512Kernels<float>() noexcept
+{
+    return KernelImpl<Avx512Float>::table("AVX-512");
+}
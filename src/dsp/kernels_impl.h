@@ -0,0 +1,217 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_kernels_impl_h
+#define laa_kernels_impl_h
+
+#include "kernels.h"
+
+// The kernels, written once against a small vector interface. Only the kernels_<isa>.cpp files include this, each
+// with its own interface built on its own intrinsics. Everything is in an anonymous namespace, so every one of these
+// files gets its own copy compiled for its own instruction set, and nothing from the standard library is used,
+// so no inline function built for avx can leak out to code that runs on any cpu.
+//
+// The vector interface V has:
+//   Real, Vec, Mask, width (number of Real in a Vec)
+//   load, store (unaligned), set1, add, sub, mul, div, sqrt, min, max, abs
+//   signBit (only the sign bits of x), orBits
+//   greater(a, b) -> Mask, select(mask, ifTrue, ifFalse)
+//   split(a, b, re, im): two vectors of interleaved complex numbers to one of real and one of imaginary parts
+//   join(re, im, a, b): the other way round
+
+namespace { // NOLINT(cert-dcl59-cpp,google-build-namespaces) one copy per instruction set, see above
+
+template <class V>
+struct KernelImpl {
+    using T = typename V::Real;
+    using Vec = typename V::Vec;
+    static constexpr size_t width = V::width;
+
+    /**
+     * \brief Run body over all elements, width at a time
+     * The tail is copied into zero padded buffers, so body only ever sees whole vectors.
+     * \tparam In, Out number of T per element in the inputs and in out. 2 for complex
+     * \param body gets the output and an array of N inputs
+     */
+    template <size_t In, size_t Out, size_t N, class Body>
+    static void run(T* out, const T* const (&in)[N], size_t count, Body body) noexcept
+    {
+        const T* src[N] = {}; // NOLINT
+        size_t i = 0;
+        for (; i + width <= count; i += width) {
+            for (size_t k = 0; k < N; k++) {
+                src[k] = in[k] + i * In; // NOLINT
+            }
+            body(out + i * Out, src); // NOLINT
+        }
+        if (i == count) {
+            return;
+        }
+
+        const size_t rest = count - i;
+        T buffers[N][2 * width] = {}; // NOLINT
+        T bufOut[2 * width] = {}; // NOLINT
+        for (size_t k = 0; k < N; k++) {
+            copy(buffers[k], in[k] + i * In, rest * In); // NOLINT
+            src[k] = buffers[k]; // NOLINT
+        }
+        body(bufOut, src);
+        copy(out + i * Out, bufOut, rest * Out); // NOLINT
+    }
+
+    static void copy(T* dst, const T* src, size_t count) noexcept
+    {
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = src[i]; // NOLINT
+        }
+    }
+
+    static void scale(T* data, size_t count, T factor) noexcept
+    {
+        const Vec f = V::set1(factor);
+        run<1, 1>(data, { data }, count, [f](T* dst, const T* const* src) {
+            V::store(dst, V::mul(V::load(src[0]), f)); // NOLINT
+        });
+    }
+
+    static void multiply(T* out, const T* a, const T* b, size_t count) noexcept
+    {
+        run<1, 1>(out, { a, b }, count, [](T* dst, const T* const* src) {
+            V::store(dst, V::mul(V::load(src[0]), V::load(src[1]))); // NOLINT
+        });
+    }
+
+    static void magnitude(T* out, const T* in, size_t count) noexcept
+    {
+        run<2, 1>(out, { in }, count, [](T* dst, const T* const* src) {
+            Vec re;
+            Vec im;
+            V::split(V::load(src[0]), V::load(src[0] + width), re, im); // NOLINT
+            V::store(dst, V::sqrt(V::add(V::mul(re, re), V::mul(im, im))));
+        });
+    }
+
+    static void magnitudeSplit(T* out, const T* re, const T* im, size_t count) noexcept
+    {
+        run<1, 1>(out, { re, im }, count, [](T* dst, const T* const* src) {
+            const Vec x = V::load(src[0]); // NOLINT
+            const Vec y = V::load(src[1]); // NOLINT
+            V::store(dst, V::sqrt(V::add(V::mul(x, x), V::mul(y, y))));
+        });
+    }
+
+    static void magnitudeSquared(T* out, const T* in, size_t count) noexcept
+    {
+        run<2, 1>(out, { in }, count, [](T* dst, const T* const* src) {
+            Vec re;
+            Vec im;
+            V::split(V::load(src[0]), V::load(src[0] + width), re, im); // NOLINT
+            V::store(dst, V::add(V::mul(re, re), V::mul(im, im)));
+        });
+    }
+
+    static void phase(T* out, const T* in, size_t count) noexcept
+    {
+        run<2, 1>(out, { in }, count, [](T* dst, const T* const* src) {
+            Vec re;
+            Vec im;
+            V::split(V::load(src[0]), V::load(src[0] + width), re, im); // NOLINT
+            V::store(dst, atan2(im, re));
+        });
+    }
+
+    static void divide(T* out, const T* num, const T* den, size_t count) noexcept
+    {
+        run<2, 2>(out, { num, den }, count, [](T* dst, const T* const* src) {
+            Vec aRe;
+            Vec aIm;
+            Vec bRe;
+            Vec bIm;
+            V::split(V::load(src[0]), V::load(src[0] + width), aRe, aIm); // NOLINT
+            V::split(V::load(src[1]), V::load(src[1] + width), bRe, bIm); // NOLINT
+            storeQuotient(dst, aRe, aIm, bRe, bIm);
+        });
+    }
+
+    static void divideSplit(T* out, const T* numRe, const T* numIm, const T* denRe, const T* denIm, size_t count) noexcept
+    {
+        // the inputs count in reals, but every one of them makes a complex output
+        run<1, 2>(out, { numRe, numIm, denRe, denIm }, count, [](T* dst, const T* const* src) {
+            storeQuotient(dst, V::load(src[0]), V::load(src[1]), V::load(src[2]), V::load(src[3])); // NOLINT
+        });
+    }
+
+    /// a / b = a * conj(b) / |b|^2, stored interleaved
+    static void storeQuotient(T* dst, Vec aRe, Vec aIm, Vec bRe, Vec bIm) noexcept
+    {
+        const Vec norm = V::add(V::mul(bRe, bRe), V::mul(bIm, bIm));
+        const Vec re = V::div(V::add(V::mul(aRe, bRe), V::mul(aIm, bIm)), norm);
+        const Vec im = V::div(V::sub(V::mul(aIm, bRe), V::mul(aRe, bIm)), norm);
+        Vec lo;
+        Vec hi;
+        V::join(re, im, lo, hi);
+        V::store(dst, lo);
+        V::store(dst + width, hi); // NOLINT
+    }
+
+    /**
+     * \brief atan2 without a single branch
+     * Folds the angle into [0, pi/4], then into [-pi/8, pi/8] around pi/8 with atan(t) = pi/4 + atan((t-1)/(t+1)),
+     * where the cephes atanf polynomial is good to a few float ulp. Then unfolds it into the right octant.
+     */
+    static Vec atan2(Vec y, Vec x) noexcept
+    {
+        const Vec zero = V::set1(T(0.0));
+        const Vec one = V::set1(T(1.0));
+        const Vec pi = V::set1(T(3.14159265358979323846));
+        const Vec halfPi = V::set1(T(1.57079632679489661923));
+        const Vec quarterPi = V::set1(T(0.78539816339744830962));
+        const Vec tanPi8 = V::set1(T(0.41421356237309504880));
+
+        const Vec ax = V::abs(x);
+        const Vec ay = V::abs(y);
+        const Vec big = V::max(ax, ay);
+        const Vec small = V::min(ax, ay);
+        // 0 / 0 gives nan here, which the select throws away again
+        Vec t = V::select(V::greater(big, zero), V::div(small, big), zero);
+        const auto shifted = V::greater(t, tanPi8);
+        t = V::select(shifted, V::div(V::sub(t, one), V::add(t, one)), t);
+
+        const Vec z = V::mul(t, t);
+        Vec p = V::set1(T(8.05374449538e-2));
+        p = V::add(V::mul(p, z), V::set1(T(-1.38776856032e-1)));
+        p = V::add(V::mul(p, z), V::set1(T(1.99777106478e-1)));
+        p = V::add(V::mul(p, z), V::set1(T(-3.33329491539e-1)));
+        Vec r = V::add(V::mul(V::mul(p, z), t), t);
+        r = V::add(r, V::select(shifted, quarterPi, zero));
+
+        r = V::select(V::greater(ay, ax), V::sub(halfPi, r), r);
+        r = V::select(V::greater(zero, x), V::sub(pi, r), r);
+        // r is positive here, so or-ing in the sign of y gets -0.0 right as well
+        return V::orBits(r, V::signBit(y));
+    }
+
+    static const SpectralKernelTable<T>& table(const char* name) noexcept
+    {
+        static const SpectralKernelTable<T> kernels = { name, &scale, &multiply, &magnitude, &magnitudeSplit, &magnitudeSquared, &phase, &divide, &divideSplit };
+        return kernels;
+    }
+};
+
+} // namespace
+
+#endif //laa_kernels_impl_h
@@ -0,0 +1,105 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// sse2 is part of x86-64, so this one runs everywhere we dispatch at all.
+// Do not include anything from the standard library here, see kernels_impl.h
+
+#include "kernels_impl.h"
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2Double {
+    using Real = double;
+    using Vec = __m128d;
+    using Mask = __m128d;
+    static constexpr size_t width = 2;
+
+    static Vec load(const double* src) noexcept { return _mm_loadu_pd(src); }
+    static void store(double* dst, Vec v) noexcept { _mm_storeu_pd(dst, v); }
+    static Vec set1(double v) noexcept { return _mm_set1_pd(v); }
+    static Vec add(Vec a, Vec b) noexcept { return _mm_add_pd(a, b); }
+    static Vec sub(Vec a, Vec b) noexcept { return _mm_sub_pd(a, b); }
+    static Vec mul(Vec a, Vec b) noexcept { return _mm_mul_pd(a, b); }
+    static Vec div(Vec a, Vec b) noexcept { return _mm_div_pd(a, b); }
+    static Vec sqrt(Vec a) noexcept { return _mm_sqrt_pd(a); }
+    static Vec min(Vec a, Vec b) noexcept { return _mm_min_pd(a, b); }
+    static Vec max(Vec a, Vec b) noexcept { return _mm_max_pd(a, b); }
+    static Vec abs(Vec a) noexcept { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static Vec signBit(Vec a) noexcept { return _mm_and_pd(_mm_set1_pd(-0.0), a); }
+    static Vec orBits(Vec a, Vec b) noexcept { return _mm_or_pd(a, b); }
+    static Mask greater(Vec a, Vec b) noexcept { return _mm_cmpgt_pd(a, b); }
+    static Vec select(Mask m, Vec a, Vec b) noexcept { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+    static void split(Vec a, Vec b, Vec& re, Vec& im) noexcept
+    {
+        re = _mm_unpacklo_pd(a, b);
+        im = _mm_unpackhi_pd(a, b);
+    }
+    static void join(Vec re, Vec im, Vec& a, Vec& b) noexcept
+    {
+        a = _mm_unpacklo_pd(re, im);
+        b = _mm_unpackhi_pd(re, im);
+    }
+};
+
+struct Sse2Float {
+    using Real = float;
+    using Vec = __m128;
+    using Mask = __m128;
+    static constexpr size_t width = 4;
+
+    static Vec load(const float* src) noexcept { return _mm_loadu_ps(src); }
+    static void store(float* dst, Vec v) noexcept { _mm_storeu_ps(dst, v); }
+    static Vec set1(float v) noexcept { return _mm_set1_ps(v); }
+    static Vec add(Vec a, Vec b) noexcept { return _mm_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b) noexcept { return _mm_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) noexcept { return _mm_mul_ps(a, b); }
+    static Vec div(Vec a, Vec b) noexcept { return _mm_div_ps(a, b); }
+    static Vec sqrt(Vec a) noexcept { return _mm_sqrt_ps(a); }
+    static Vec min(Vec a, Vec b) noexcept { return _mm_min_ps(a, b); }
+    static Vec max(Vec a, Vec b) noexcept { return _mm_max_ps(a, b); }
+    static Vec abs(Vec a) noexcept { return _mm_andnot_ps(_mm_set1_ps(-0.0F), a); }
+    static Vec signBit(Vec a) noexcept { return _mm_and_ps(_mm_set1_ps(-0.0F), a); }
+    static Vec orBits(Vec a, Vec b) noexcept { return _mm_or_ps(a, b); }
+    static Mask greater(Vec a, Vec b) noexcept { return _mm_cmpgt_ps(a, b); }
+    static Vec select(Mask m, Vec a, Vec b) noexcept { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static void split(Vec a, Vec b, Vec& re, Vec& im) noexcept
+    {
+        re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+    static void join(Vec re, Vec im, Vec& a, Vec& b) noexcept
+    {
+        a = _mm_unpacklo_ps(re, im);
+        b = _mm_unpackhi_ps(re, im);
+    }
+};
+
+} // namespace
+
+template <>
+const SpectralKernelTable<double>& sse2Kernels<double>() noexcept
+{
+    return KernelImpl<Sse2Double>::table("SSE2");
+}
+
+template <>
+const SpectralKernelTable<float>& sse2Kernels<float>() noexcept
+{
+    return KernelImpl<Sse2Float>::table("SSE2");
+}
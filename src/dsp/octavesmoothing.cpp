@@ -0,0 +1,126 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "octavesmoothing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+namespace {
+/// bins past the smoothed ones are taken over as they are
+template <class Out, class In>
+void copyRest(Out out, In in, size_t smoothed) noexcept
+{
+    auto offset = static_cast<std::ptrdiff_t>(std::min(smoothed, in.size()));
+    std::copy(in.begin() + offset, in.end(), out.begin() + offset);
+}
+}
+
+std::shared_ptr<const OctaveSmoothing> OctaveSmoothing::get(size_t bins, size_t fraction) noexcept
+{
+    static std::mutex cacheLock;
+    static std::map<std::pair<size_t, size_t>, std::weak_ptr<const OctaveSmoothing>> cache;
+
+    // the states hold the smoothings they use. Once the last one lets go, the smoothing is gone, and so is its entry
+    std::lock_guard<std::mutex> lock(cacheLock);
+    for (auto iter = cache.begin(); iter != cache.end();) {
+        iter = iter->second.expired() ? cache.erase(iter) : std::next(iter);
+    }
+    auto& entry = cache[{ bins, fraction }];
+    auto smoothing = entry.lock();
+    if (smoothing == nullptr) {
+        smoothing = std::make_shared<const OctaveSmoothing>(bins, fraction);
+        entry = smoothing;
+    }
+    return smoothing;
+}
+
+OctaveSmoothing::OctaveSmoothing(size_t bins, size_t fraction) noexcept
+    : bandFraction(fraction)
+{
+    // bin k is at k * fs / n, so the band edges are k * 2^(+-1/(2*fraction)) in bins
+    double halfBand = std::pow(2.0, 1.0 / (2.0 * static_cast<double>(std::max(fraction, static_cast<size_t>(1)))));
+    lower.resize(bins);
+    upper.resize(bins);
+    for (size_t k = 0; k < bins; k++) {
+        auto dk = static_cast<double>(k);
+        auto low = static_cast<size_t>(std::ceil(dk / halfBand));
+        auto high = static_cast<size_t>(std::floor(dk * halfBand)) + 1;
+        // a band narrower than a bin is just the bin
+        lower[k] = static_cast<uint32_t>(std::min(low, k));
+        upper[k] = static_cast<uint32_t>(std::clamp(high, k + 1, bins));
+    }
+}
+
+bool OctaveSmoothing::matches(size_t bins, size_t fraction) const noexcept
+{
+    return bins == lower.size() && fraction == bandFraction;
+}
+
+template <class Acc, class Value, class Store>
+void OctaveSmoothing::slide(Value value, Store store) const noexcept
+{
+    // a global prefix sum would lose the quiet parts of the spectrum to rounding, as the sum is dominated by the loud parts.
+    // instead, the sum is rebuilt once the range moved past the range it was built for. Ranges grow with frequency,
+    // so that only happens every so many bins, and the rounding error stays local.
+    Acc sum = {};
+    size_t low = 0;
+    size_t high = 0;
+    size_t rebuildAt = 0;
+    for (size_t k = 0; k < lower.size(); k++) {
+        if (k == 0 || lower[k] >= rebuildAt) {
+            sum = {};
+            for (size_t i = lower[k]; i < upper[k]; i++) {
+                sum += value(i);
+            }
+            rebuildAt = upper[k];
+        } else {
+            for (size_t i = high; i < upper[k]; i++) {
+                sum += value(i);
+            }
+            for (size_t i = low; i < lower[k]; i++) {
+                sum -= value(i);
+            }
+        }
+        low = lower[k];
+        high = upper[k];
+        store(k, sum, static_cast<Real>(high - low));
+    }
+}
+
+void OctaveSmoothing::smoothPower(RealSpan out, ConstRealSpan in) const noexcept
+{
+    slide<Real>([&in](size_t i) { return in[i] * in[i]; },
+        [&out](size_t k, Real sum, Real count) { out[k] = std::sqrt(std::max<Real>(sum, 0.0) / count); });
+    copyRest(out, in, lower.size());
+}
+
+void OctaveSmoothing::smoothLinear(RealSpan out, ConstRealSpan in) const noexcept
+{
+    slide<Real>([&in](size_t i) { return in[i]; },
+        [&out](size_t k, Real sum, Real count) { out[k] = sum / count; });
+    copyRest(out, in, lower.size());
+}
+
+void OctaveSmoothing::smoothComplex(ComplexSpan out, ConstComplexSpan in) const noexcept
+{
+    slide<Complex>([&in](size_t i) { return in[i]; },
+        [&out](size_t k, Complex sum, Real count) { out[k] = sum / count; });
+    copyRest(out, in, lower.size());
+}
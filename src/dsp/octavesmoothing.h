@@ -0,0 +1,99 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_octavesmoothing_h
+#define laa_octavesmoothing_h
+
+#include "fft.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * \brief Fractional octave smoothing over the bins of a spectrum
+ * Bin k is averaged over all bins within 1/fraction octave around it. The ranges only depend on the number of bins
+ * and the fraction, so they are computed once and shared. The ranges only ever move up, so the sums slide along the
+ * spectrum and every smoothed trace costs O(bins), no matter the bandwidth.
+ */
+class OctaveSmoothing {
+public:
+    /// the fractions the ui offers. 0 stands for the old fixed width smoothing
+    static constexpr size_t fractions[] = { 1, 3, 6, 12, 24, 48 };
+
+    /**
+     * \brief Get the shared smoothing for a bin count and fraction
+     * The cache does not keep smoothings alive, so hold on to it as long as you use it.
+     * \note Locks a cache. Do not call from the audio callback
+     * \param bins number of bins to smooth, dc up to nyquist
+     * \param fraction 1/fraction octave
+     * \return the smoothing
+     */
+    static std::shared_ptr<const OctaveSmoothing> get(size_t bins, size_t fraction) noexcept;
+
+    /**
+     * \brief ctor. Use \sa get instead
+     * \param bins number of bins to smooth, dc up to nyquist
+     * \param fraction 1/fraction octave
+     */
+    OctaveSmoothing(size_t bins, size_t fraction) noexcept;
+
+    /**
+     * \brief Check if this smoothing is the one for the given parameters
+     * \return true if it is
+     */
+    [[nodiscard]] bool matches(size_t bins, size_t fraction) const noexcept;
+
+    /**
+     * \brief Smooth magnitudes in the power domain, sqrt(mean(in^2))
+     * \param out smoothed magnitudes. Bins past the smoothed ones are copied over.
+     * \param in magnitudes
+     */
+    void smoothPower(RealSpan out, ConstRealSpan in) const noexcept;
+
+    /**
+     * \brief Smooth values as they are
+     * \param out smoothed values. Bins past the smoothed ones are copied over.
+     * \param in values
+     */
+    void smoothLinear(RealSpan out, ConstRealSpan in) const noexcept;
+
+    /**
+     * \brief Smooth complex values as vectors, so phase is smoothed along with the magnitude
+     * \param out smoothed values. Bins past the smoothed ones are copied over.
+     * \param in values
+     */
+    void smoothComplex(ComplexSpan out, ConstComplexSpan in) const noexcept;
+
+private:
+    /**
+     * \brief Slide the sum of value(i) over the ranges of all bins
+     * \param value gets the value of a bin
+     * \param store gets a bin, the sum and the number of bins summed
+     */
+    template <class Acc, class Value, class Store>
+    void slide(Value value, Store store) const noexcept;
+
+    /// first bin of the range of each bin
+    std::vector<uint32_t> lower = {};
+    /// one past the last bin of the range of each bin
+    std::vector<uint32_t> upper = {};
+    /// 1/bandwidth in octaves
+    size_t bandFraction = 0;
+};
+
+#endif //laa_octavesmoothing_h
@@ -19,10 +19,11 @@
 #define laa_peak_h
 
 #include <algorithm>
-#include <vector>
+#include <cmath>
+#include <limits>
 
-template <class T, class Talloc = std::allocator<T>>
-size_t findMax(const std::vector<T, Talloc>& in)
+template <class Container>
+size_t findMax(const Container& in)
 {
     size_t max = 0;
     double maxVal = std::numeric_limits<double>::min();
@@ -36,8 +37,8 @@ size_t findMax(const std::vector<T, Talloc>& in)
     return max;
 }
 
-template <class T, class Talloc = std::allocator<T>>
-size_t findAbsMax(const std::vector<T, Talloc>& in)
+template <class Container>
+size_t findAbsMax(const Container& in)
 {
     size_t max = 0;
     double maxVal = 0.0;
@@ -51,8 +52,8 @@ size_t findAbsMax(const std::vector<T, Talloc>& in)
     return max;
 }
 
-template <class T, class Talloc = std::allocator<T>>
-size_t findMin(const std::vector<T, Talloc>& in)
+template <class Container>
+size_t findMin(const Container& in)
 {
     size_t min = 0;
     double minVal = std::numeric_limits<double>::max();
@@ -20,7 +20,7 @@
 double PinkNoiseGenerator::nextSample() noexcept
 {
     const double gainFactor = 0.1;
-    double white = WhiteNoiseGenerator::nextSample();
+    double white = whiteNoise.nextSample();
     b0 = 0.99886 * b0 + white * 0.0555179 * gainFactor;
     b1 = 0.99332 * b1 + white * 0.0750759 * gainFactor;
     b2 = 0.96900 * b2 + white * 0.1538520 * gainFactor;
@@ -27,6 +27,7 @@ public:
     double nextSample() noexcept;
 
 private:
+    WhiteNoiseGenerator whiteNoise = {};
     double b0 = 0.0;
     double b1 = 0.0;
     double b2 = 0.0;
@@ -5,24 +5,22 @@
 #ifndef LAA_SMOOTHING_H
 #define LAA_SMOOTHING_H
 
+#include "fft.h"
+#include <algorithm>
 #include <cmath>
-#include <vector>
 
-template <class T, class Talloc = std::allocator<double>>
-void smooth(std::vector<T, Talloc>& out, const std::vector<T, Talloc>& in, size_t maxLen = 0)
+template <class T>
+void smooth(Span<T> out, Span<const typename std::remove_const<T>::type> in, size_t maxLen = 0)
 {
-    if (out.size() != in.size()) {
-        out.resize(in.size(), 0.0F);
-    }
-    if (maxLen == 0) {
-        maxLen = out.size();
+    if (maxLen == 0 || maxLen > std::min(out.size(), in.size())) {
+        maxLen = std::min(out.size(), in.size());
     }
     for (size_t writeIndex = 0; writeIndex < maxLen; ++writeIndex) {
         out[writeIndex] = 0.0;
         size_t readStart = writeIndex > 10 ? writeIndex - 10 : 0;
         size_t readEnd = writeIndex + 10;
         for (size_t readIndex = readStart; readIndex < readEnd && readIndex < maxLen; ++readIndex) {
-            double absDist = std::abs(static_cast<double>(readEnd - readStart));
+            Real absDist = std::abs(static_cast<Real>(readEnd - readStart));
             out[writeIndex] += in[readIndex] / absDist;
         }
     }
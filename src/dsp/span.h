@@ -0,0 +1,99 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_span_h
+#define laa_span_h
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/**
+ * \brief A view of count elements that live somewhere else, like the arrays of a StateData in its arena
+ * Like std::span, constness is shallow: a const Span still lets you write the elements. Span<const T> does not.
+ * \tparam T element type
+ */
+template <class T>
+class Span {
+public:
+    Span() noexcept = default;
+    Span(T* start, size_t length) noexcept
+        : first(start)
+        , count(length)
+    {
+    }
+    /// view a whole vector
+    template <class Alloc>
+    Span(std::vector<std::remove_const_t<T>, Alloc>& vec) noexcept // NOLINT(google-explicit-constructor) stands in for the vector
+        : first(vec.data())
+        , count(vec.size())
+    {
+    }
+    /// view a whole const vector. Only for Span<const T>
+    template <class Alloc, class U = T, class = std::enable_if_t<std::is_const_v<U>>>
+    Span(const std::vector<std::remove_const_t<T>, Alloc>& vec) noexcept // NOLINT(google-explicit-constructor)
+        : first(vec.data())
+        , count(vec.size())
+    {
+    }
+    /// Span<T> to Span<const T>
+    template <class U, class = std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>>>
+    Span(const Span<U>& other) noexcept // NOLINT(google-explicit-constructor)
+        : first(other.data())
+        , count(other.size())
+    {
+    }
+    Span(const Span&) noexcept = default;
+    Span& operator=(const Span&) noexcept = default;
+    ~Span() noexcept = default;
+
+    [[nodiscard]] T* data() const noexcept
+    {
+        return first;
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return count;
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return count == 0;
+    }
+
+    T& operator[](size_t index) const noexcept
+    {
+        return first[index]; // NOLINT
+    }
+
+    [[nodiscard]] T* begin() const noexcept
+    {
+        return first;
+    }
+
+    [[nodiscard]] T* end() const noexcept
+    {
+        return first + count; // NOLINT
+    }
+
+private:
+    T* first = nullptr;
+    size_t count = 0;
+};
+
+#endif //laa_span_h
@@ -0,0 +1,123 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spectrumaverage.h"
+
+#include <algorithm>
+
+namespace {
+/// splitting bin loops smaller than this costs more than it brings
+constexpr size_t minBinsPerTask = 4096;
+}
+
+SpectrumHistory::SpectrumHistory(size_t bins, size_t frames) noexcept
+    : binCount(bins)
+    , frameCount(frames)
+    , values(new Real[bins * frames]) // NOLINT the history does not need clearing, see SpectrumAverage::clear
+{
+}
+
+size_t SpectrumHistory::maxFrames(size_t bins) noexcept
+{
+    return std::max(maxBytes / (std::max(bins, static_cast<size_t>(1)) * sizeof(Real)), static_cast<size_t>(1));
+}
+
+bool SpectrumAverage::configure(size_t bins, SpectrumAveraging mode, size_t frames, std::shared_ptr<SpectrumHistory> frameHistory) noexcept
+{
+    frames = std::max(frames, static_cast<size_t>(1));
+    if (mode == SpectrumAveraging::Frames) {
+        if (frameHistory == nullptr || frameHistory->binCount != bins || frameHistory->frameCount < frames) {
+            return false;
+        }
+    } else {
+        frameHistory = nullptr;
+    }
+    if (bins == binCount && mode == averaging && frames == frameCount && frameHistory == history) {
+        return true;
+    }
+
+    binCount = bins;
+    averaging = mode;
+    frameCount = frames;
+    history = std::move(frameHistory);
+    // the only allocation here. A few MB at most, the history is the big part
+    sum.assign(binCount, 0.0);
+
+    clear();
+    return true;
+}
+
+void SpectrumAverage::clear() noexcept
+{
+    // the history does not need clearing, filled says which part of it is valid
+    std::fill(sum.begin(), sum.end(), 0.0);
+    filled = 0;
+    writePos = 0;
+}
+
+void SpectrumAverage::add(RealSpan inOut, TaskPool& pool) noexcept
+{
+    if (averaging != SpectrumAveraging::Frames) {
+        // exponential behaves like a plain mean until there are enough frames, so the start is not dominated by the first frame.
+        // infinite never stops being a plain mean
+        filled = averaging == SpectrumAveraging::Exponential ? std::min(filled + 1, frameCount) : filled + 1;
+        double weight = 1.0 / static_cast<double>(filled);
+        pool.parallelFor(binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                sum[i] += weight * (inOut[i] - sum[i]);
+                inOut[i] = static_cast<Real>(sum[i]);
+            }
+        });
+        return;
+    }
+
+    // the oldest frame leaves the sum, the new one takes its slot and enters
+    bool full = filled == frameCount;
+    filled = std::min(filled + 1, frameCount);
+    double scale = 1.0 / static_cast<double>(filled);
+    Real* slot = history->values.get() + writePos * binCount; // NOLINT
+    pool.parallelFor(binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (full) {
+                sum[i] -= slot[i]; // NOLINT
+            }
+            slot[i] = inOut[i]; // NOLINT
+            sum[i] += inOut[i];
+            // rounding must not take an all zero bin below zero
+            inOut[i] = static_cast<Real>(std::max(sum[i], 0.0) * scale);
+        }
+    });
+    writePos = (writePos + 1) % frameCount;
+
+    // once per trip around the history. keeps the cost O(bins) per frame on average
+    if (full && writePos == 0) {
+        rebuild(pool);
+    }
+}
+
+void SpectrumAverage::rebuild(TaskPool& pool) noexcept
+{
+    const Real* frames = history->values.get();
+    pool.parallelFor(binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            sum[i] = 0.0;
+            for (size_t frame = 0; frame < filled; frame++) {
+                sum[i] += frames[frame * binCount + i]; // NOLINT
+            }
+        }
+    });
+}
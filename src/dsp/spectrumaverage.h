@@ -0,0 +1,114 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef laa_spectrumaverage_h
+#define laa_spectrumaverage_h
+
+#include "../audio/taskpool.h"
+#include "fft.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * \brief How spectra are averaged over frames
+ */
+enum class SpectrumAveraging {
+    /// plain mean over the last n frames
+    Frames,
+    /// exponential average with a time constant of n frames
+    Exponential,
+    /// mean over every frame since the last clear
+    Infinite
+};
+
+/**
+ * \brief The frames a SpectrumAverage keeps for SpectrumAveraging::Frames, one after the other
+ * Made up front by whoever picks the settings, so the averaging never allocates on the thread that publishes frames.
+ */
+struct SpectrumHistory {
+    /// the history of one average is capped to this. At 4M points a frame is 16 MB in double
+    static constexpr size_t maxBytes = static_cast<size_t>(256) * 1024 * 1024;
+
+    /**
+     * \brief Make a history. The memory is not touched here, the os maps it in as the frames come in
+     * \param bins number of bins of a frame
+     * \param frames number of frames
+     */
+    SpectrumHistory(size_t bins, size_t frames) noexcept;
+
+    /**
+     * \brief Most frames of a length that fit into maxBytes
+     * \param bins number of bins of a frame
+     * \return frame count, at least 1
+     */
+    static size_t maxFrames(size_t bins) noexcept;
+
+    size_t binCount = 0;
+    size_t frameCount = 0;
+    std::unique_ptr<Real[]> values = nullptr; // NOLINT
+};
+
+/**
+ * \brief Averages a real spectrum over frames
+ * Every frame costs the same, no matter how many frames are averaged: frame averaging keeps a running sum that the
+ * newest frame enters and the oldest one leaves, the other modes only keep the average itself.
+ * The running sum is rebuilt from the history once per trip around it.
+ */
+class SpectrumAverage {
+public:
+    /**
+     * \brief Set up the average. Clears it if anything changed
+     * \param bins number of bins
+     * \param mode averaging mode
+     * \param frames number of frames to average over, or time constant in frames. Not used by SpectrumAveraging::Infinite
+     * \param frameHistory history for SpectrumAveraging::Frames, with bins bins and at least frames frames
+     * \return false if mode needs a history and frameHistory does not fit. add() must not be called then
+     */
+    bool configure(size_t bins, SpectrumAveraging mode, size_t frames, std::shared_ptr<SpectrumHistory> frameHistory) noexcept;
+
+    /**
+     * \brief Forget all frames
+     */
+    void clear() noexcept;
+
+    /**
+     * \brief Add a frame and replace it with the average
+     * \param inOut the frame. Receives the average
+     * \param pool bins are split up over this pool
+     */
+    void add(RealSpan inOut, TaskPool& pool) noexcept;
+
+private:
+    /// rebuild the running sum from the history, so rounding errors do not pile up
+    void rebuild(TaskPool& pool) noexcept;
+
+    size_t binCount = 0;
+    SpectrumAveraging averaging = SpectrumAveraging::Frames;
+    size_t frameCount = 1;
+    /// frames added since the last clear. Stops at frameCount, except for SpectrumAveraging::Infinite
+    size_t filled = 0;
+    /// next history slot to write
+    size_t writePos = 0;
+    /// running sum for SpectrumAveraging::Frames, the average for the others.
+    /// double, so the sum does not drift away from the history over millions of frames
+    std::vector<double> sum = {};
+    /// the last frameCount frames, only for SpectrumAveraging::Frames
+    std::shared_ptr<SpectrumHistory> history = nullptr;
+};
+
+#endif //laa_spectrumaverage_h
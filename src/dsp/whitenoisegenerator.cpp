@@ -16,12 +16,13 @@
  */
 
 #include "whitenoisegenerator.h"
-#include <random>
+
+WhiteNoiseGenerator::WhiteNoiseGenerator() noexcept
+    : engine(std::random_device()())
+{
+}
 
 double WhiteNoiseGenerator::nextSample() noexcept
 {
-    static std::random_device rd;
-    static std::default_random_engine re(rd());
-    static std::uniform_real_distribution<double> unif(-1.0, 1.0);
-    return unif(re);
+    return distribution(engine);
 }
@@ -18,9 +18,17 @@
 #ifndef laa_whitenoisegenerator_h
 #define laa_whitenoisegenerator_h
 
+#include <random>
+
 class WhiteNoiseGenerator {
 public:
-    static double nextSample() noexcept;
+    WhiteNoiseGenerator() noexcept;
+    double nextSample() noexcept;
+
+private:
+    // seeded in the ctor, so nothing is set up lazily on the audio thread
+    std::default_random_engine engine;
+    std::uniform_real_distribution<double> distribution { -1.0, 1.0 };
 };
 
 #endif //laa_whitenoisegenerator_h
@@ -0,0 +1,184 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "windows.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+/**
+ * \brief Modified bessel function of the first kind, order 0
+ * \param x argument
+ * \return I0(x)
+ */
+double besselI0(double x) noexcept
+{
+    // the series converges quickly for the betas that make sense for windows
+    double sum = 1.0;
+    double term = 1.0;
+    double halfX = x / 2.0;
+    for (int k = 1; k < 64; k++) {
+        term *= halfX / static_cast<double>(k);
+        double squared = term * term;
+        sum += squared;
+        if (squared < sum * 1e-17) {
+            break;
+        }
+    }
+    return sum;
+}
+
+/**
+ * \brief Sum of cosine terms, sum a[k] * cos(2 * pi * k * n / m) with alternating signs
+ */
+template <size_t N>
+double cosineSum(const double (&a)[N], double n, double m) noexcept
+{
+    double value = 0.0;
+    double sign = 1.0;
+    for (size_t k = 0; k < N; k++) {
+        value += sign * a[k] * std::cos(2.0 * M_PI * static_cast<double>(k) * n / m);
+        sign = -sign;
+    }
+    return value;
+}
+}
+
+std::shared_ptr<const WindowTable> WindowTable::get(WindowFunction function, size_t length, double beta) noexcept
+{
+    static std::mutex cacheLock;
+    static std::map<std::tuple<WindowFunction, size_t, double>, std::weak_ptr<const WindowTable>> cache;
+
+    // beta only matters for kaiser, dont make a table per beta for the others
+    if (function != WindowFunction::Kaiser) {
+        beta = 0.0;
+    }
+
+    // the states hold the tables they use. A table for an old length or every kaiser beta dragged through
+    // is gone once the last state moved on, and so is its entry
+    std::lock_guard<std::mutex> lock(cacheLock);
+    for (auto iter = cache.begin(); iter != cache.end();) {
+        iter = iter->second.expired() ? cache.erase(iter) : std::next(iter);
+    }
+    auto& entry = cache[{ function, length, beta }];
+    auto table = entry.lock();
+    if (table == nullptr) {
+        table = std::make_shared<const WindowTable>(function, length, beta);
+        entry = table;
+    }
+    return table;
+}
+
+WindowTable::WindowTable(WindowFunction function, size_t length, double beta) noexcept
+    : windowFunction(function)
+    , windowBeta(function == WindowFunction::Kaiser ? beta : 0.0)
+{
+    static constexpr double hamming[] = { 0.54, 0.46 };
+    static constexpr double blackman[] = { 0.42, 0.5, 0.08 };
+    static constexpr double hann[] = { 0.5, 0.5 };
+    static constexpr double blackmanHarris[] = { 0.35875, 0.48829, 0.14128, 0.01168 };
+    static constexpr double flatTop[] = { 0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368 };
+
+    coefficients.resize(length);
+    auto m = static_cast<double>(length > 1 ? length - 1 : 1);
+    double kaiserNorm = besselI0(windowBeta);
+    for (size_t i = 0; i < length; i++) {
+        auto n = static_cast<double>(i);
+        double value = 1.0;
+        switch (windowFunction) {
+        case WindowFunction::None:
+            value = 1.0;
+            break;
+        case WindowFunction::Hamming:
+            value = cosineSum(hamming, n, m);
+            break;
+        case WindowFunction::Blackman:
+            value = cosineSum(blackman, n, m);
+            break;
+        case WindowFunction::Hann:
+            value = cosineSum(hann, n, m);
+            break;
+        case WindowFunction::BlackmanHarris:
+            value = cosineSum(blackmanHarris, n, m);
+            break;
+        case WindowFunction::FlatTop:
+            value = cosineSum(flatTop, n, m);
+            break;
+        case WindowFunction::Kaiser: {
+            double x = 2.0 * n / m - 1.0;
+            value = besselI0(windowBeta * std::sqrt(std::max(0.0, 1.0 - x * x))) / kaiserNorm;
+            break;
+        }
+        }
+        // the gains come from the exact values, not the ones rounded to processing precision
+        coefficients[i] = static_cast<Real>(value);
+        sum += value;
+        sumSquares += value * value;
+    }
+}
+
+bool WindowTable::matches(WindowFunction function, size_t length, double beta) const noexcept
+{
+    return function == windowFunction && length == coefficients.size() && (function != WindowFunction::Kaiser || std::abs(beta - windowBeta) < 1e-9);
+}
+
+void WindowTable::apply(RealSpan out, ConstRealSpan in) const noexcept
+{
+    kernels().multiply(out.data(), in.data(), coefficients.data(), std::min({ coefficients.size(), in.size(), out.size() }));
+}
+
+void WindowTable::applyPacked(ComplexSpan out, ConstRealSpan re, ConstRealSpan im) const noexcept
+{
+    // complex numbers are laid out as two reals, so this plain loop over plain pointers vectorizes
+    const Real* window = coefficients.data();
+    const Real* srcRe = re.data();
+    const Real* srcIm = im.data();
+    auto* dst = reinterpret_cast<Real*>(out.data()); // NOLINT
+    const size_t count = std::min({ coefficients.size(), re.size(), im.size(), out.size() });
+    for (size_t i = 0; i < count; i++) {
+        dst[2 * i] = srcRe[i] * window[i]; // NOLINT
+        dst[2 * i + 1] = srcIm[i] * window[i]; // NOLINT
+    }
+}
+
+double WindowTable::coherentGain() const noexcept
+{
+    return coefficients.empty() ? 1.0 : sum / static_cast<double>(coefficients.size());
+}
+
+double WindowTable::enbw() const noexcept
+{
+    return sum <= 0.0 ? 1.0 : static_cast<double>(coefficients.size()) * sumSquares / (sum * sum);
+}
+
+double WindowTable::magnitudeCorrection(WindowScaling scaling) const noexcept
+{
+    switch (scaling) {
+    case WindowScaling::None:
+        break;
+    case WindowScaling::CoherentGain:
+        return coherentGain();
+    case WindowScaling::Enbw:
+        return coherentGain() * std::sqrt(enbw());
+    }
+
+    return 1.0;
+}
@@ -18,35 +18,107 @@
 #ifndef laa_hamming_h
 #define laa_hamming_h
 
-#include <cmath>
+#include "fft.h"
+
+#include <memory>
 #include <vector>
 
-template <class T, class Talloc = std::allocator<T>>
-inline void hamming(std::vector<T, Talloc>& out, const std::vector<T, Talloc>& in)
-{
-    auto M = static_cast<double>(in.size() - 1);
-    for (size_t i = 0; i < in.size(); i++) {
-        auto di = static_cast<double>(i);
-        out[i] = in[i] * (0.54 - 0.46 * std::cos(2.0 * M_PI * di / M));
-    }
-}
-
-template <class T, class Talloc = std::allocator<T>>
-inline void blackman(std::vector<T, Talloc>& out, const std::vector<T, Talloc>& in)
-{
-    auto M = static_cast<double>(in.size() - 1);
-    for (size_t i = 0; i < in.size(); i++) {
-        auto di = static_cast<double>(i);
-        out[i] = in[i] * (0.42 - 0.5 * std::cos(2.0 * M_PI * di / M) + 0.08 * std::cos(4.0 * M_PI * di / M));
-    }
-}
-
-template <class T, class Talloc = std::allocator<T>>
-inline void noWindow(std::vector<T, Talloc>& out, const std::vector<T, Talloc>& in)
-{
-    for (size_t i = 0; i < in.size(); i++) {
-        out[i] = in[i];
-    }
-}
+/**
+ * \brief The window functions we know
+ */
+enum class WindowFunction {
+    None,
+    Hamming,
+    Blackman,
+    Hann,
+    BlackmanHarris,
+    FlatTop,
+    Kaiser
+};
+
+/**
+ * \brief How a windowed magnitude spectrum is corrected for the energy the window takes away
+ */
+enum class WindowScaling {
+    /// not at all
+    None,
+    /// divide by the coherent gain. Tones show their true amplitude
+    CoherentGain,
+    /// divide by the rms of the window, i.e. coherent gain times sqrt(enbw). Broadband noise shows its true level
+    Enbw
+};
+
+/**
+ * \brief Precomputed coefficients of a window function
+ * Windows are shared between all frames of the same length, so the trig is done once and not per frame.
+ */
+class WindowTable {
+public:
+    /**
+     * \brief Get the shared table for a window
+     * The cache does not keep tables alive, so hold on to it as long as you use it.
+     * \note Locks a cache. Do not call from the audio callback
+     * \param function the window function
+     * \param length number of samples
+     * \param beta shape parameter, only used by WindowFunction::Kaiser
+     * \return the table
+     */
+    static std::shared_ptr<const WindowTable> get(WindowFunction function, size_t length, double beta) noexcept;
+
+    /**
+     * \brief ctor. Use \sa get instead
+     * \param function the window function
+     * \param length number of samples
+     * \param beta shape parameter, only used by WindowFunction::Kaiser
+     */
+    WindowTable(WindowFunction function, size_t length, double beta) noexcept;
+
+    /**
+     * \brief Check if this table is the one for the given parameters
+     * \return true if it is
+     */
+    [[nodiscard]] bool matches(WindowFunction function, size_t length, double beta) const noexcept;
+
+    /**
+     * \brief Multiply in with the window
+     * \param out windowed samples
+     * \param in samples. Same size as the window
+     */
+    void apply(RealSpan out, ConstRealSpan in) const noexcept;
+
+    /**
+     * \brief Multiply two signals with the window and pack them into one complex signal, re + i * im
+     * \param out packed windowed samples
+     * \param re samples for the real part. Same size as the window
+     * \param im samples for the imaginary part. Same size as the window
+     */
+    void applyPacked(ComplexSpan out, ConstRealSpan re, ConstRealSpan im) const noexcept;
+
+    /**
+     * \brief Mean of the coefficients
+     * \return coherent gain
+     */
+    [[nodiscard]] double coherentGain() const noexcept;
+
+    /**
+     * \brief Equivalent noise bandwidth in bins
+     * \return enbw
+     */
+    [[nodiscard]] double enbw() const noexcept;
+
+    /**
+     * \brief What to divide magnitudes by for a scaling
+     * \param scaling the scaling
+     * \return the divisor
+     */
+    [[nodiscard]] double magnitudeCorrection(WindowScaling scaling) const noexcept;
+
+private:
+    WindowFunction windowFunction = WindowFunction::None;
+    double windowBeta = 0.0;
+    RealVec coefficients = {};
+    double sum = 0.0;
+    double sumSquares = 0.0;
+};
 
 #endif //laa_hamming_h
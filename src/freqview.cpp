@@ -24,7 +24,7 @@ void FreqView::update(StateManager& stateManager, std::string idHint)
     ImGui::BeginChild((idHint + "Freq").c_str());
 
     const auto& liveState = stateManager.getLive();
-    const auto& data = choose(smoothing, liveState.smoothedTransferFunction, liveState.transferFunction);
+    const auto& data = choose(smoothing, liveState.data->smoothedTransferFunction, liveState.data->transferFunction);
 
     auto size = ImGui::GetWindowContentRegionMax();
     PlotConfig plotConfig;
@@ -48,20 +48,21 @@ void FreqView::update(StateManager& stateManager, std::string idHint)
 
     if (liveState.visible) {
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = liveState.fftLen / 2;
+        const auto& values = curves.get(liveState.data, data, kernels().magnitude);
+        sourceConfig.count = liveState.data->fftLen / 2;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = liveState.sampleRate / 2.0;
+        sourceConfig.xMax = liveState.data->sampleRate / 2.0;
         sourceConfig.color = liveState.uniqueCol;
         sourceConfig.active = liveState.active;
         sourceConfig.antiAliasingBehaviour = AntiAliasingBehaviour::Mean;
         Plot(
             sourceConfig,
-            [&data](size_t idx) {
-                if (idx >= data.size()) {
+            [&values](size_t idx) -> double {
+                if (idx >= values.size()) {
                     return 0.0;
                 }
 
-                return mag(data[idx]);
+                return values[idx];
             });
     }
 
@@ -69,24 +70,26 @@ void FreqView::update(StateManager& stateManager, std::string idHint)
         if (!state.visible) {
             continue;
         }
-        auto& savedData = choose(smoothing, state.smoothedTransferFunction, state.transferFunction);
+        auto& savedData = choose(smoothing, state.data->smoothedTransferFunction, state.data->transferFunction);
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = state.fftLen / 2;
+        const auto& savedValues = curves.get(state.data, savedData, kernels().magnitude);
+        sourceConfig.count = state.data->fftLen / 2;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = state.sampleRate / 2;
+        sourceConfig.xMax = state.data->sampleRate / 2;
         sourceConfig.color = state.uniqueCol;
         sourceConfig.active = state.active;
         sourceConfig.antiAliasingBehaviour = AntiAliasingBehaviour::Mean;
         Plot(
-            sourceConfig, [&savedData](size_t idx) {
-                if (idx >= savedData.size()) {
+            sourceConfig, [&savedValues](size_t idx) -> double {
+                if (idx >= savedValues.size()) {
                     return 0.0;
                 }
-                return mag(savedData[idx]);
+                return savedValues[idx];
             });
     }
 
     EndPlot();
+    curves.prune();
     ImGui::SameLine();
     VMidpointSlider("##yRangeIR", 0.05, 10.0, 2.0, yRange, ImVec2(30.0F, plotConfig.size.y), [](double) { return std::string(); });
 
@@ -18,6 +18,7 @@
 #ifndef laa_freqview_h
 #define laa_freqview_h
 
+#include "curvecache.h"
 #include "statemanager.h"
 
 class FreqView {
@@ -29,6 +30,7 @@ private:
     double max = 20000.0;
     double yRange = 2.0;
     bool smoothing = true;
+    CurveCache curves = {};
 };
 
 #endif //laa_freqview_h
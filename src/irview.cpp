@@ -30,9 +30,9 @@ void IrView::update(StateManager& stateManager, std::string idHint)
     ImGui::SetColumnWidth(-1, plotWidth);
 
     const auto& liveState = stateManager.getLive();
-    const auto& data = choose(smoothing, liveState.smoothedImpulseResponse, liveState.impulseResponse);
+    const auto& data = choose(smoothing, liveState.data->smoothedImpulseResponse, liveState.data->impulseResponse);
     // make sure range doesn't clip
-    range = std::clamp(range, 0.0, liveState.fftDuration);
+    range = std::clamp(range, 0.0, liveState.data->fftDuration);
 
     PlotConfig plotConfig;
     plotConfig.label = "IR View";
@@ -55,10 +55,10 @@ void IrView::update(StateManager& stateManager, std::string idHint)
     if (liveState.visible) {
         PlotSourceConfig sourceConfig;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = liveState.fftDuration;
+        sourceConfig.xMax = liveState.data->fftDuration;
         sourceConfig.color = liveState.uniqueCol;
         sourceConfig.active = liveState.active;
-        sourceConfig.count = liveState.fftLen;
+        sourceConfig.count = liveState.data->fftLen;
         sourceConfig.antiAliasingBehaviour = AntiAliasingBehaviour::AbsMax;
         auto clicked = Plot(
             sourceConfig,
@@ -77,11 +77,11 @@ void IrView::update(StateManager& stateManager, std::string idHint)
         if (!state.visible) {
             continue;
         }
-        const auto& stateData = choose(smoothing, state.smoothedImpulseResponse, state.impulseResponse);
+        const auto& stateData = choose(smoothing, state.data->smoothedImpulseResponse, state.data->impulseResponse);
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = state.fftLen;
+        sourceConfig.count = state.data->fftLen;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = state.fftDuration;
+        sourceConfig.xMax = state.data->fftDuration;
         sourceConfig.color = state.uniqueCol;
         sourceConfig.active = state.active;
         sourceConfig.antiAliasingBehaviour = AntiAliasingBehaviour::AbsMax;
@@ -118,7 +118,7 @@ void IrView::update(StateManager& stateManager, std::string idHint)
     VMidpointSlider("##yRangeIR", 0.01, 2.0, 0.1, yRange, ImVec2(30.0F, plotConfig.size.y), [](double) { return std::string(); });
 
     float fRange = static_cast<float>(range);
-    ImGui::SliderFloat("Range", &fRange, 0.0F, static_cast<float>(liveState.fftDuration), "%.3f", 5.0F);
+    ImGui::SliderFloat("Range", &fRange, 0.0F, static_cast<float>(liveState.data->fftDuration), "%.3f", 5.0F);
     range = static_cast<double>(fRange);
     ImGui::Checkbox("Show Absolute Values", &showAbsValues);
     ImGui::SameLine();
@@ -164,7 +164,7 @@ void IrView::update(StateManager& stateManager, std::string idHint)
     ImGui::EndChild();
 }
 
-void IrView::addMarker(const StateData& state, const PlotClickInfo& info) noexcept
+void IrView::addMarker(const DisplayState& state, const PlotClickInfo& info) noexcept
 {
     IrMarker marker;
     marker.clickInfo = info;
@@ -179,17 +179,18 @@ void IrView::clearRef() noexcept
     }
 }
 
-IrMarker makeMarkerFromPeak(const StateData& stateData)
+IrMarker makeMarkerFromPeak(const DisplayState& state)
 {
+    const auto& stateData = *state.data;
     size_t index = findAbsMax(stateData.impulseResponse);
-    double yVal = stateData.impulseResponse[index];
-    double xVal = stateData.fftDuration * static_cast<double>(index) / static_cast<double>(stateData.fftLen);
+    double yVal = stateData.impulseResponse.empty() ? 0.0 : stateData.impulseResponse[index];
+    double xVal = stateData.fftLen == 0 ? 0.0 : stateData.fftDuration * static_cast<double>(index) / static_cast<double>(stateData.fftLen);
 
     IrMarker result = {};
     result.clickInfo.clicked = true;
     result.clickInfo.x = xVal;
     result.clickInfo.y = yVal;
-    result.color = stateData.uniqueCol;
+    result.color = state.uniqueCol;
 
     return result;
 }
@@ -33,7 +33,7 @@ public:
     void update(StateManager& stateManager, std::string idHint);
 
 private:
-    void addMarker(const StateData& state, const PlotClickInfo& info) noexcept;
+    void addMarker(const DisplayState& state, const PlotClickInfo& info) noexcept;
     double range = 1.0;
     double yRange = 0.51;
     bool smoothing = false;
@@ -24,7 +24,7 @@ void MagView::update(StateManager& stateManager, std::string idHint)
     ImGui::BeginChild((idHint + "Mag").c_str());
 
     const auto& liveState = stateManager.getLive();
-    auto& data = choose(smoothing, liveState.smoothedAvgMag, liveState.avgMag);
+    auto& data = choose(smoothing, liveState.data->smoothedAvgMag, liveState.data->avgMag);
 
     auto size = ImGui::GetWindowContentRegionMax();
     PlotConfig plotConfig;
@@ -47,14 +47,14 @@ void MagView::update(StateManager& stateManager, std::string idHint)
 
     if (liveState.visible) {
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = liveState.fftLen / 2;
+        sourceConfig.count = liveState.data->fftLen / 2;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = liveState.sampleRate / 2.0;
+        sourceConfig.xMax = liveState.data->sampleRate / 2.0;
         sourceConfig.color = liveState.uniqueCol;
         sourceConfig.active = liveState.active;
         Plot(
             sourceConfig,
-            [&data](size_t idx) {
+            [&data](size_t idx) -> double {
                 if (idx >= data.size()) {
                     return 0.0;
                 }
@@ -67,15 +67,15 @@ void MagView::update(StateManager& stateManager, std::string idHint)
         if (!state.visible) {
             continue;
         }
-        auto& savedData = choose(smoothing, state.smoothedAvgMag, state.avgMag);
+        auto& savedData = choose(smoothing, state.data->smoothedAvgMag, state.data->avgMag);
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = state.fftLen / 2;
+        sourceConfig.count = state.data->fftLen / 2;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = state.sampleRate / 2.0;
+        sourceConfig.xMax = state.data->sampleRate / 2.0;
         sourceConfig.color = state.uniqueCol;
         sourceConfig.active = state.active;
         Plot(
-            sourceConfig, [&savedData](size_t idx) {
+            sourceConfig, [&savedData](size_t idx) -> double {
                 if (idx >= savedData.size()) {
                     return 0.0;
                 }
@@ -22,7 +22,7 @@ void PhaseView::update(StateManager& stateManager, std::string idHint)
     ImGui::BeginChild((idHint + "Phase").c_str());
 
     const auto& liveState = stateManager.getLive();
-    const auto& data = choose(smoothing, liveState.smoothedTransferFunction, liveState.transferFunction);
+    const auto& data = choose(smoothing, liveState.data->smoothedTransferFunction, liveState.data->transferFunction);
 
     auto size = ImGui::GetWindowContentRegionMax();
     PlotConfig plotConfig;
@@ -45,20 +45,21 @@ void PhaseView::update(StateManager& stateManager, std::string idHint)
 
     if (liveState.visible) {
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = liveState.fftLen / 2;
+        const auto& values = curves.get(liveState.data, data, kernels().phase);
+        sourceConfig.count = liveState.data->fftLen / 2;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = liveState.sampleRate / 2.0;
+        sourceConfig.xMax = liveState.data->sampleRate / 2.0;
         sourceConfig.color = liveState.uniqueCol;
         sourceConfig.active = liveState.active;
         sourceConfig.antiAliasingBehaviour = AntiAliasingBehaviour::AbsMax;
         Plot(
             sourceConfig,
-            [&data](size_t idx) {
-                if (idx >= data.size()) {
+            [&values](size_t idx) -> double {
+                if (idx >= values.size()) {
                     return 0.0;
                 }
 
-                return phase(data[idx]);
+                return values[idx];
             });
     }
 
@@ -66,23 +67,25 @@ void PhaseView::update(StateManager& stateManager, std::string idHint)
         if (!state.visible) {
             continue;
         }
-        const auto& savedData = choose(smoothing, state.smoothedTransferFunction, state.transferFunction);
+        const auto& savedData = choose(smoothing, state.data->smoothedTransferFunction, state.data->transferFunction);
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = state.fftLen / 2;
+        const auto& savedValues = curves.get(state.data, savedData, kernels().phase);
+        sourceConfig.count = state.data->fftLen / 2;
         sourceConfig.xMin = 0.0;
-        sourceConfig.xMax = state.sampleRate / 2.0;
+        sourceConfig.xMax = state.data->sampleRate / 2.0;
         sourceConfig.color = state.uniqueCol;
         sourceConfig.active = state.active;
         Plot(
-            sourceConfig, [&savedData](size_t idx) {
-                if (idx >= savedData.size()) {
+            sourceConfig, [&savedValues](size_t idx) -> double {
+                if (idx >= savedValues.size()) {
                     return 0.0;
                 }
-                return phase(savedData[idx]);
+                return savedValues[idx];
             });
     }
 
     EndPlot();
+    curves.prune();
 
     ImGui::PushItemWidth(plotConfig.size.x / 3.0F);
     MidpointSlider("min##freq", 30.0, 20000.0, 1000.0, min);
@@ -18,6 +18,7 @@
 #ifndef laa_phaseview_h
 #define laa_phaseview_h
 
+#include "curvecache.h"
 #include "statemanager.h"
 
 class PhaseView {
@@ -28,6 +29,7 @@ private:
     double min = 30.0F;
     double max = 20000.0F;
     bool smoothing = true;
+    CurveCache curves = {};
 };
 
 #endif //laa_phaseview_h
@@ -22,7 +22,7 @@ void SignalView::update(StateManager& stateManager, std::string idHint) noexcept
     ImGui::BeginChild((idHint + "Signal").c_str());
 
     const auto& liveState = stateManager.getLive();
-    const auto& data = liveState.input;
+    const auto& data = liveState.data->input;
     (void)data;
     auto size = ImGui::GetWindowContentRegionMax();
     PlotConfig plotConfig;
@@ -37,7 +37,7 @@ void SignalView::update(StateManager& stateManager, std::string idHint) noexcept
 #pragma GCC diagnostic ignored "-Wfloat-equal"
 #endif
     if (min == 0.0F) {
-        min = static_cast<float>(0.0 - liveState.fftDuration);
+        min = static_cast<float>(0.0 - liveState.data->fftDuration);
     }
 #if defined(__GNUC__)
 #pragma GCC diagnostic pop
@@ -50,8 +50,8 @@ void SignalView::update(StateManager& stateManager, std::string idHint) noexcept
     BeginPlot(plotConfig);
     if (liveState.visible) {
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = liveState.fftLen;
-        sourceConfig.xMin = 0.0 - liveState.fftDuration;
+        sourceConfig.count = liveState.data->fftLen;
+        sourceConfig.xMin = 0.0 - liveState.data->fftDuration;
         sourceConfig.xMax = 0.0;
         sourceConfig.color = liveState.uniqueCol;
         sourceConfig.active = liveState.active;
@@ -67,23 +67,23 @@ void SignalView::update(StateManager& stateManager, std::string idHint) noexcept
         }
 
         PlotSourceConfig sourceConfig;
-        sourceConfig.count = state.fftLen;
-        sourceConfig.xMin = 0.0 - state.fftDuration;
+        sourceConfig.count = state.data->fftLen;
+        sourceConfig.xMin = 0.0 - state.data->fftDuration;
         sourceConfig.xMax = 0.0;
         sourceConfig.color = state.uniqueCol;
         sourceConfig.active = state.active;
         Plot(
-            sourceConfig, [&state](size_t idx) {
-                if (idx >= state.input.size()) {
+            sourceConfig, [&state](size_t idx) -> double {
+                if (idx >= state.data->input.size()) {
                     return 0.0;
                 }
-                return state.input[idx];
+                return state.data->input[idx];
             });
     }
 
     EndPlot();
 
-    ImGui::SliderFloat("Range", &min, static_cast<float>(0.0 - liveState.fftDuration), 0.0F);
+    ImGui::SliderFloat("Range", &min, static_cast<float>(0.0 - liveState.data->fftDuration), 0.0F);
 
     ImGui::EndChild();
 }
@@ -17,108 +17,297 @@
 
 #include "state.h"
 #include "dsp/smoothing.h"
+#include <algorithm>
+#include <cstring>
+
+StateData::StateData(size_t length) noexcept
+    : fftLen(length)
+    , binCount(length / 2 + 1)
+    , arena(layout(nullptr))
+{
+    layout(arena.data());
+}
+
+StateData::StateData(const StateData& other) noexcept
+    : fftLen(other.fftLen)
+    , binCount(other.binCount)
+    , fftDuration(other.fftDuration)
+    , sampleRate(other.sampleRate)
+    , serial(other.serial)
+    // a copy is a snapshot, written once and read a few times. Huge pages make it slower, see laabench copy
+    , arena(other.arena.size(), false, false)
+{
+    if (arena.size() != 0) {
+        std::memcpy(arena.data(), other.arena.data(), arena.size());
+    }
+    layout(arena.data());
+}
+
+size_t StateData::layout(std::byte* base) noexcept
+{
+    size_t offset = 0;
+    auto carve = [base, &offset](auto& span, size_t count) {
+        using Element = std::remove_reference_t<decltype(span[0])>;
+        if (base != nullptr) {
+            span = { reinterpret_cast<Element*>(base + offset), count }; // NOLINT
+        }
+        offset += Arena::alignUp(count * sizeof(Element));
+    };
+    // in the order they are used, so a frame walks through memory front to back.
+    // the imaginary parts of a spectrum follow right after its real parts, \sa FftPlan::splitImagOffset
+    for (auto* buffer : { &input, &reference, &windowedInput, &windowedReference }) {
+        carve(*buffer, fftLen);
+    }
+    for (auto* buffer : { &fftInput.re, &fftInput.im, &fftReference.re, &fftReference.im, &avgMag, &smoothedAvgMag }) {
+        carve(*buffer, binCount);
+    }
+    carve(transferFunction, binCount);
+    carve(smoothedTransferFunction, binCount);
+    carve(impulseResponse, fftLen);
+    carve(smoothedImpulseResponse, fftLen);
+    carve(psdEstimateInput, binCount);
+    carve(psdEstimateReference, binCount);
+    carve(csdEstimate, binCount);
+    carve(coherence, binCount);
+    carve(smoothedCoherence, binCount);
+    return offset;
+}
 
 State::State(size_t fftLen) noexcept
+    : data(std::min(LAA_MAX_FFT_LENGTH, std::max(LAA_MIN_FFT_LENGTH, fftLen)))
+{
+    // the plans run on our buffers, so every state of a length can share them
+    forwardPlan = FftPlan::get(data.fftLen, FftDirection::ForwardSplit);
+    backwardPlan = FftPlan::get(data.fftLen, FftDirection::Backward);
+}
+
+State::~State() noexcept = default;
+
+void State::calcSpectrum(TaskPool& pool) noexcept
 {
-    data.uniqueCol = ImGui::GetColorU32(ImGuiCol_Text);
-    data.fftLen = std::min(LAA_MAX_FFT_LENGTH, std::max(LAA_MIN_FFT_LENGTH, fftLen));
-    data.input.resize(data.fftLen);
-    data.reference.resize(data.fftLen);
-    data.windowedInput.resize(data.fftLen);
-    data.windowedReference.resize(data.fftLen);
-    data.fftInput.resize(data.fftLen);
-    data.fftReference.resize(data.fftLen);
-    data.avgMag.resize(data.fftLen);
-    data.smoothedAvgMag.resize(data.fftLen);
-    data.transferFunction.resize(data.fftLen);
-    data.smoothedTransferFunction.resize(data.fftLen);
-    data.impulseResponse.resize(data.fftLen);
-    data.smoothedImpulseResponse.resize(data.fftLen);
-    data.psdEstimateInput.resize(data.fftLen);
-    data.psdEstimateReference.resize(data.fftLen);
-    data.csdEstimate.resize(data.fftLen);
-    data.coherence.resize(data.fftLen);
-    data.smoothedCoherence.resize(data.fftLen);
-
-    fftInputPlan = fftw_plan_dft_r2c_1d(static_cast<int>(data.fftLen), reinterpret_cast<double*>(data.windowedInput.data()), reinterpret_cast<fftw_complex*>(data.fftInput.data()), FFTW_MEASURE);
-    fftReferencePlan = fftw_plan_dft_r2c_1d(static_cast<int>(data.fftLen), reinterpret_cast<double*>(data.windowedReference.data()), reinterpret_cast<fftw_complex*>(data.fftReference.data()), FFTW_MEASURE);
-    impulseResponsePlan = fftw_plan_dft_c2r_1d(static_cast<int>(data.fftLen), reinterpret_cast<fftw_complex*>(data.transferFunction.data()), reinterpret_cast<double*>(data.impulseResponse.data()), FFTW_MEASURE | FFTW_PRESERVE_INPUT);
-}
-
-State::~State() noexcept
-{
-    fftw_destroy_plan(impulseResponsePlan);
-    fftw_destroy_plan(fftReferencePlan);
-    fftw_destroy_plan(fftInputPlan);
-}
-
-void State::calc(StateFilterConfig& filterConfig) noexcept
-{
-    // copy input into windows
-    switch (filterConfig.windowFilter) {
-
-    case StateWindowFilter::None:
-        noWindow(data.windowedInput, data.input);
-        noWindow(data.windowedReference, data.reference);
-        break;
-    case StateWindowFilter::Hamming:
-        hamming(data.windowedInput, data.input);
-        hamming(data.windowedReference, data.reference);
-        break;
-    case StateWindowFilter::Blackman:
-        blackman(data.windowedInput, data.input);
-        blackman(data.windowedReference, data.reference);
-        break;
-    }
-
-    // run fft for input and reference
-    fftw_execute(fftInputPlan);
-    fftw_execute(fftReferencePlan);
+    calcFft(pool);
+    calcSpectralProducts(pool);
+    calcSmoothing(pool);
+}
+
+void State::calcFft(TaskPool& pool) noexcept
+{
+    // the window only changes with the settings, so we hold on to it and only look it up on a change
+    if (window == nullptr || !window->matches(settings.windowFilter, data.fftLen, settings.kaiserBeta)) {
+        window = WindowTable::get(settings.windowFilter, data.fftLen, settings.kaiserBeta);
+    }
+
+    if (settings.fftMode == FftMode::PackedComplex) {
+        calcPackedFft(pool);
+    } else {
+        // copy input into windows and run the fft. input and reference do not depend on each other
+        auto windowAndFft = [this](RealSpan windowed, ConstRealSpan in, SplitSpan fft) {
+            window->apply(windowed, in);
+            forwardPlan->execute(windowed, fft);
+        };
+        pool.run({ [&]() { windowAndFft(data.windowedInput, data.input, data.fftInput); },
+            [&]() { windowAndFft(data.windowedReference, data.reference, data.fftReference); } });
+    }
 
     // make things we can derive from the fft
-    auto dFftLen = static_cast<double>(data.fftLen);
-    for (size_t i = 0; i < data.fftLen; i++) {
+    const auto& kernel = kernels();
+    auto normalization = static_cast<Real>(1.0 / static_cast<double>(data.fftLen));
+    // the window takes away some energy. the magnitude gets it back, if asked to
+    auto magScale = static_cast<Real>(1.0 / window->magnitudeCorrection(settings.windowScaling));
+    pool.parallelFor(data.binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+        size_t count = end - begin;
         // normalize first
-        data.fftInput[i] /= dFftLen;
-        data.fftReference[i] /= dFftLen;
+        for (auto* part : { &data.fftInput.re, &data.fftInput.im, &data.fftReference.re, &data.fftReference.im }) {
+            kernel.scale(&(*part)[begin], count, normalization);
+        }
         // magnitude into avgMag
-        data.avgMag[i] = mag(data.fftInput[i]);
-        // transfer function:  XxH = Y => H = Y/X
-        data.transferFunction[i] = data.fftInput[i] / data.fftReference[i];
+        kernel.magnitudeSplit(&data.avgMag[begin], &data.fftInput.re[begin], &data.fftInput.im[begin], count);
+        kernel.scale(&data.avgMag[begin], count, magScale);
+    });
+
+    // transfer function:  XxH = Y => H = Y/X
+    // the cross spectrum does this with all the frames when averaging
+    if (settings.spectrumEstimator == SpectrumEstimator::NeighbourBins) {
+        pool.parallelFor(data.binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+            kernel.divideSplit(interleaved(&data.transferFunction[begin]), &data.fftInput.re[begin], &data.fftInput.im[begin],
+                &data.fftReference.re[begin], &data.fftReference.im[begin], end - begin);
+        });
     }
+}
 
-    // filter magnitude
-    filterConfig.makeAvg(data.avgMag, data.fftLen);
+void State::calcPackedFft(TaskPool& pool) noexcept
+{
+    if (packedPlan == nullptr) {
+        packedPlan = FftPlan::get(data.fftLen, FftDirection::ComplexForward);
+        packed.resize(data.fftLen);
+        packedBytes.store(packed.capacity() * sizeof(Complex), std::memory_order_relaxed);
+    }
+
+    // z = x + iy. The spectra of real signals are conjugate symmetric, so with Zc[k] = conj(Z[N - k]):
+    // X[k] = (Z[k] + Zc[k]) / 2 and Y[k] = (Z[k] - Zc[k]) / 2i
+    window->applyPacked(packed, data.input, data.reference);
+    // the windowed signals are part of the frame in both modes, so they are pulled out before the fft runs in place
+    pool.parallelFor(data.fftLen, minBinsPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            data.windowedInput[i] = packed[i].real();
+            data.windowedReference[i] = packed[i].imag();
+        }
+    });
+    packedPlan->execute(packed);
+    const Complex half = 0.5;
+    const Complex minusHalfI = Complex(0.0, -0.5);
+    pool.parallelFor(data.binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Complex z = packed[i];
+            Complex zc = conj(packed[i == 0 ? 0 : data.fftLen - i]);
+            Complex x = (z + zc) * half;
+            Complex y = (z - zc) * minusHalfI;
+            data.fftInput.re[i] = x.real();
+            data.fftInput.im[i] = x.imag();
+            data.fftReference.re[i] = y.real();
+            data.fftReference.im[i] = y.imag();
+        }
+    });
+}
+
+void State::calcSpectralProducts(TaskPool& pool) noexcept
+{
+    if (settings.spectrumEstimator != SpectrumEstimator::NeighbourBins) {
+        return;
+    }
 
     // divide our range into segments
     // estimate psd and csd over these segments
     // then estimate the squared coherence at a point.
+    // the window around bin i is [i - psdDepth, i + psdDepth), clipped to dc and nyquist.
+    // moving from one bin to the next adds one bin at the top and drops one at the bottom, so we slide the sums along
+    // instead of summing up the whole window every time. Every now and then the sums are rebuilt, so rounding errors
+    // from all the adding and dropping do not pile up. Every range of bins starts with a rebuild, so they split up nicely.
     size_t psdDepth = std::clamp(data.fftLen / 1024ull, 64ull, 512ull);
-    for (size_t i = 0; i < data.fftLen; i++) {
-        size_t start = i < psdDepth ? 0 : i - psdDepth;
-        size_t end = std::min(data.fftLen, i + psdDepth);
-        data.psdEstimateInput[i] = 0.0;
-        data.psdEstimateReference[i] = 0.0;
-        data.csdEstimate[i] = 0.0;
-        for (size_t j = start; j < end; j++) {
-            data.psdEstimateReference[i] += magSquared(data.fftReference[j]);
-            data.psdEstimateInput[i] += magSquared(data.fftInput[j]);
-            data.csdEstimate[i] += conj(data.fftReference[j]) * data.fftInput[j];
+    const auto& x = data.fftReference;
+    const auto& y = data.fftInput;
+    auto power = [](const SplitSpan& spectrum, size_t j) {
+        return spectrum.re[j] * spectrum.re[j] + spectrum.im[j] * spectrum.im[j];
+    };
+    // conj(X) * Y
+    auto cross = [&x, &y](size_t j) {
+        return Complex(x.re[j] * y.re[j] + x.im[j] * y.im[j], x.re[j] * y.im[j] - x.im[j] * y.re[j]);
+    };
+    pool.parallelFor(data.binCount, minBinsPerTask, [&](size_t begin, size_t end) {
+        Real psdInput = 0.0;
+        Real psdReference = 0.0;
+        Complex csd = 0.0;
+        for (size_t i = begin; i < end; i++) {
+            if ((i - begin) % coherenceRebuildInterval == 0) {
+                size_t start = i < psdDepth ? 0 : i - psdDepth;
+                size_t stop = std::min(data.binCount, i + psdDepth);
+                psdInput = 0.0;
+                psdReference = 0.0;
+                csd = 0.0;
+                for (size_t j = start; j < stop; j++) {
+                    psdReference += power(x, j);
+                    psdInput += power(y, j);
+                    csd += cross(j);
+                }
+            } else {
+                // bin i - 1 + psdDepth enters, bin i - 1 - psdDepth leaves
+                size_t entering = i - 1 + psdDepth;
+                if (entering < data.binCount) {
+                    psdReference += power(x, entering);
+                    psdInput += power(y, entering);
+                    csd += cross(entering);
+                }
+                if (i > psdDepth) {
+                    size_t leaving = i - 1 - psdDepth;
+                    psdReference -= power(x, leaving);
+                    psdInput -= power(y, leaving);
+                    csd -= cross(leaving);
+                }
+            }
+            data.psdEstimateInput[i] = psdInput;
+            data.psdEstimateReference[i] = psdReference;
+            data.csdEstimate[i] = csd;
+            data.coherence[i] = magSquared(csd) / (psdReference * psdInput);
         }
-        data.coherence[i] = magSquared(data.csdEstimate[i]) / (data.psdEstimateReference[i] * data.psdEstimateInput[i]);
-    }
+    });
+
+    calcImpulseResponse(pool);
+}
 
+void State::calcImpulseResponse(TaskPool& pool) noexcept
+{
     // compute impulse response
-    fftw_execute(impulseResponsePlan);
+    backwardPlan->execute(data.transferFunction, data.impulseResponse);
     // normalize
-    for (size_t i = 0; i < data.fftLen; i++) {
-        data.impulseResponse[i] /= dFftLen;
+    auto normalization = static_cast<Real>(1.0 / static_cast<double>(data.fftLen));
+    pool.parallelFor(data.fftLen, minBinsPerTask, [&](size_t begin, size_t end) {
+        kernels().scale(&data.impulseResponse[begin], end - begin, normalization);
+    });
+}
+
+void State::calcSmoothing(TaskPool& pool) noexcept
+{
+    if (settings.spectrumEstimator == SpectrumEstimator::NeighbourBins) {
+        smoothResults(pool);
     }
-    // smooth out things
-    smooth(data.smoothedAvgMag, data.avgMag);
-    smooth(data.smoothedTransferFunction, data.transferFunction);
-    smooth(data.smoothedImpulseResponse, data.impulseResponse);
-    smooth(data.smoothedCoherence, data.coherence);
+}
+
+void State::smoothResults(TaskPool& pool) noexcept
+{
+    // smooth out things. these do not depend on each other
+    // the ir lives in the time domain, octaves make no sense there
+    if (settings.smoothingFraction == 0) {
+        pool.run({ [&]() { smooth(data.smoothedTransferFunction, data.transferFunction); },
+            [&]() { smooth(data.smoothedImpulseResponse, data.impulseResponse); },
+            [&]() { smooth(data.smoothedCoherence, data.coherence); } });
+        return;
+    }
+
+    // the transfer function is smoothed as vectors, so phase and magnitude stay together
+    const auto& octaves = octaveSmoothing();
+    pool.run({ [&]() { octaves.smoothComplex(data.smoothedTransferFunction, data.transferFunction); },
+        [&]() { smooth(data.smoothedImpulseResponse, data.impulseResponse); },
+        [&]() { octaves.smoothLinear(data.smoothedCoherence, data.coherence); } });
+}
+
+const OctaveSmoothing& State::octaveSmoothing() noexcept
+{
+    // like the window, we hold on to it and only look it up on a change
+    if (smoothing == nullptr || !smoothing->matches(data.binCount, settings.smoothingFraction)) {
+        smoothing = OctaveSmoothing::get(data.binCount, settings.smoothingFraction);
+    }
+    return *smoothing;
+}
+
+void State::calcAverage(StateFilterConfig& filterConfig, TaskPool& pool) noexcept
+{
+    // filter magnitude
+    filterConfig.apply(settings);
+    filterConfig.makeAvg(data.avgMag, data.binCount, pool);
+    if (settings.smoothingFraction == 0) {
+        smooth(data.smoothedAvgMag, data.avgMag);
+    } else {
+        // magnitudes are smoothed as power
+        octaveSmoothing().smoothPower(data.smoothedAvgMag, data.avgMag);
+    }
+
+    if (settings.spectrumEstimator != SpectrumEstimator::CrossSpectrum) {
+        return;
+    }
+
+    // add this frame to the cross spectrum, and derive everything from it.
+    // this replaces both the per frame division and the neighbour bin coherence
+    auto& crossSpectrum = filterConfig.crossSpectrum;
+    crossSpectrum.configure(data.binCount, settings.crossSpectrumAveraging, settings.crossSpectrumFrames);
+    crossSpectrum.add(data.fftInput, data.fftReference, pool);
+    crossSpectrum.estimate(settings.transferEstimator, data.transferFunction, data.coherence, data.psdEstimateInput, data.psdEstimateReference, data.csdEstimate, pool);
+    calcImpulseResponse(pool);
+    smoothResults(pool);
+}
+
+void State::setSettings(const StateFilterSettings& newSettings) noexcept
+{
+    settings = newSettings;
 }
 
 const StateData& State::getData() noexcept
@@ -131,44 +320,49 @@ StateData& State::accessData() noexcept
     return data;
 }
 
-StateFilterConfig::StateFilterConfig() noexcept
+size_t State::memoryUsage() const noexcept
 {
-    avgMagnitudes.resize(LAA_MAX_FFT_AVG, RealVec());
-    for (size_t i = 0; i < LAA_MAX_FFT_AVG; i++) {
-        avgMagnitudes[i].resize(LAA_MAX_FFT_LENGTH);
-    }
+    return sizeof(State) + data.arena.size() + packedBytes.load(std::memory_order_relaxed);
 }
+
+StateFilterConfig::StateFilterConfig() noexcept = default;
+
 void StateFilterConfig::clearAvg() noexcept
 {
-    for (size_t i = 0; i < LAA_MAX_FFT_AVG; i++) {
-        for (size_t j = 0; j < LAA_MAX_FFT_LENGTH; j++) {
-            avgMagnitudes[i][j] = 0.0;
-        }
-    }
+    magnitudeAverage.clear();
 }
 
-void StateFilterConfig::makeAvg(RealVec& inOut, size_t fftLen) noexcept
+void StateFilterConfig::apply(const StateFilterSettings& settings) noexcept
 {
-    if (avgCount == 0) {
-        return;
-    }
-
-    if (fftLen != lastFftLen) {
+    if (settings.avgResetSerial != avgResetSerial) {
         clearAvg();
-        lastFftLen = fftLen;
+        crossSpectrum.clear();
+        avgResetSerial = settings.avgResetSerial;
     }
 
-    for (size_t i = 0; i < fftLen; i++) {
-        avgMagnitudes[currAvg][i] = inOut[i];
-        inOut[i] = 0.0;
-        for (size_t avgI = 0; avgI < avgCount; avgI++) {
-            inOut[i] += avgMagnitudes[avgI][i];
-        }
-        inOut[i] /= static_cast<double>(avgCount);
+    avgMode = settings.avgMode;
+    avgCount = settings.avgCount;
+    avgHistory = settings.avgHistory;
+}
+
+size_t StateFilterConfig::historyFrames(size_t count, size_t binCount) noexcept
+{
+    return std::min(count, SpectrumHistory::maxFrames(binCount));
+}
+
+void StateFilterConfig::makeAvg(RealSpan inOut, size_t binCount, TaskPool& pool) noexcept
+{
+    // averaging is off. forget what was averaged so far, or it comes back once averaging is turned on again
+    if (avgCount == 0 && avgMode != SpectrumAveraging::Infinite) {
+        magnitudeAverage.clear();
+        return;
     }
 
-    ++currAvg;
-    if (currAvg >= avgCount) {
-        currAvg = 0;
+    // clears the average if the length or mode changed.
+    // right after a length change the settings can still carry the history of the old length, until the ui published new ones
+    if (!magnitudeAverage.configure(binCount, avgMode, historyFrames(avgCount, binCount), avgHistory)) {
+        magnitudeAverage.clear();
+        return;
     }
+    magnitudeAverage.add(inOut, pool);
 }
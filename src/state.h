@@ -18,20 +18,73 @@
 #ifndef laa_state_h
 #define laa_state_h
 
+#include "audio/taskpool.h"
+#include "dsp/arena.h"
 #include "dsp/avg.h"
+#include "dsp/crossspectrum.h"
+#include "dsp/fftplan.h"
+#include "dsp/octavesmoothing.h"
+#include "dsp/spectrumaverage.h"
 #include "dsp/windows.h"
 #include "shared.h"
+#include <atomic>
 
-static constexpr size_t LAA_MAX_FFT_LENGTH = 131072;
+static constexpr size_t LAA_MAX_FFT_LENGTH = 4194304;
 static constexpr size_t LAA_MIN_FFT_LENGTH = 1024;
-static constexpr size_t LAA_MAX_FFT_AVG = 8;
+static constexpr size_t LAA_MAX_FFT_AVG = 128;
 
-enum class StateWindowFilter {
-    None,
-    Hamming,
-    Blackman
+/**
+ * \brief Where transfer function and coherence come from
+ */
+enum class SpectrumEstimator {
+    /// single frame. H is Y/X, coherence is estimated from neighbouring bins
+    NeighbourBins,
+    /// auto and cross spectra averaged over frames, \sa CrossSpectrumAccumulator
+    CrossSpectrum
+};
+
+/**
+ * \brief How the input and reference spectra are computed
+ */
+enum class FftMode {
+    /// one real fft per channel. Both run at once if there is a frame pool
+    SeparateReal,
+    /// both channels packed into one complex fft, and pulled apart by conjugate symmetry
+    PackedComplex
+};
+
+/**
+ * \brief The processing settings the ui can change
+ * The ui publishes these as immutable, versioned snapshots. Every frame gets a copy when it enters processing.
+ */
+struct StateFilterSettings {
+    /// counts up with every published change
+    size_t version = 0;
+    WindowFunction windowFilter = WindowFunction::Blackman;
+    /// shape of WindowFunction::Kaiser
+    double kaiserBeta = 8.6;
+    WindowScaling windowScaling = WindowScaling::None;
+    FftMode fftMode = FftMode::SeparateReal;
+    SpectrumAveraging avgMode = SpectrumAveraging::Frames;
+    /// frames the magnitude is averaged over, or its time constant in frames. 0 turns averaging off, except for SpectrumAveraging::Infinite
+    size_t avgCount = 2;
+    /// bumped by the ui to ask for the averaging history to be cleared
+    size_t avgResetSerial = 0;
+    /// frames for SpectrumAveraging::Frames at the capture length, made by the ui so no worker has to
+    std::shared_ptr<SpectrumHistory> avgHistory = nullptr;
+    SpectrumEstimator spectrumEstimator = SpectrumEstimator::NeighbourBins;
+    SpectrumAveraging crossSpectrumAveraging = SpectrumAveraging::Frames;
+    /// frames the cross spectrum is averaged over, or its time constant in frames
+    size_t crossSpectrumFrames = 8;
+    TransferEstimator transferEstimator = TransferEstimator::H1;
+    /// smoothing bandwidth is 1/smoothingFraction octave. 0, the default, smooths over a fixed number of bins like before
+    size_t smoothingFraction = 0;
 };
 
+/**
+ * \brief The averaging history
+ * \note Only touched in capture order, by whoever publishes frames
+ */
 struct StateFilterConfig {
     StateFilterConfig() noexcept;
     ~StateFilterConfig() noexcept = default;
@@ -40,50 +93,107 @@ struct StateFilterConfig {
     StateFilterConfig& operator=(const StateFilterConfig&) noexcept = default;
     StateFilterConfig& operator=(StateFilterConfig&&) noexcept = default;
 
-    StateWindowFilter windowFilter = StateWindowFilter::Blackman;
-    std::vector<RealVec> avgMagnitudes = {};
+    /// magnitude average. only holds the active length
+    SpectrumAverage magnitudeAverage = {};
+    SpectrumAveraging avgMode = SpectrumAveraging::Frames;
     size_t avgCount = 2;
-    size_t currAvg = 0;
-    size_t lastFftLen = 0;
-    void makeAvg(RealVec& inOut, size_t fftLen) noexcept;
+    std::shared_ptr<SpectrumHistory> avgHistory = nullptr;
+    /// avgResetSerial of the settings that were last applied
+    size_t avgResetSerial = 0;
+    /// for SpectrumEstimator::CrossSpectrum
+    CrossSpectrumAccumulator crossSpectrum = {};
+    /**
+     * \brief Take over the averaging part of settings. Clears the history if the ui asked for it
+     * \param settings the settings
+     */
+    void apply(const StateFilterSettings& settings) noexcept;
+    /**
+     * \brief Frames actually averaged over for SpectrumAveraging::Frames, avgCount capped to what the history may hold
+     * \param count avgCount
+     * \param binCount number of bins
+     * \return frame count
+     */
+    static size_t historyFrames(size_t count, size_t binCount) noexcept;
+    /**
+     * \brief Add a magnitude to the average and replace it with the average
+     * \note Leaves inOut alone if the settings have no history for this length yet
+     * \param inOut the magnitude
+     * \param binCount number of bins
+     * \param pool bins are split up over this pool
+     */
+    void makeAvg(RealSpan inOut, size_t binCount, TaskPool& pool) noexcept;
     void clearAvg() noexcept;
 };
 
+/**
+ * \brief Everything about one frame
+ * Time domain buffers hold fftLen samples. The input is real, so the upper half of its spectrum mirrors the lower half,
+ * and spectral buffers only hold the binCount = fftLen / 2 + 1 bins from dc to nyquist.
+ * All buffers are views into one arena, so a frame is a single allocation and a copy of it is a single memcpy.
+ */
 struct StateData {
+    StateData() noexcept = default;
+    /**
+     * \brief Allocate and zero all buffers
+     * \param length fft length
+     */
+    explicit StateData(size_t length) noexcept;
+    /// one allocation and one memcpy, the buffers of the copy point into its own arena. The copy does not use huge pages
+    StateData(const StateData& other) noexcept;
+    StateData(StateData&&) noexcept = default;
+    /// deleted, copy construct a new one instead
+    StateData& operator=(const StateData&) = delete;
+    StateData& operator=(StateData&&) noexcept = default;
+    ~StateData() noexcept = default;
+
     size_t fftLen = 0;
+    /// fftLen / 2 + 1
+    size_t binCount = 0;
     // raw input
-    RealVec input = {};
-    RealVec reference = {};
+    RealSpan input = {};
+    RealSpan reference = {};
     // windowed input
-    RealVec windowedInput = {};
-    RealVec windowedReference = {};
-    // fft
-    ComplexVec fftInput = {};
-    ComplexVec fftReference = {};
-    RealVec avgMag = {};
-    RealVec smoothedAvgMag = {};
+    RealSpan windowedInput = {};
+    RealSpan windowedReference = {};
+    // fft. split, so the per bin math on them vectorizes
+    SplitSpan fftInput = {};
+    SplitSpan fftReference = {};
+    RealSpan avgMag = {};
+    RealSpan smoothedAvgMag = {};
     // H and h
-    ComplexVec transferFunction = {};
-    ComplexVec smoothedTransferFunction = {};
-    RealVec impulseResponse = {};
-    RealVec smoothedImpulseResponse = {};
+    ComplexSpan transferFunction = {};
+    ComplexSpan smoothedTransferFunction = {};
+    RealSpan impulseResponse = {};
+    RealSpan smoothedImpulseResponse = {};
     // coherence and PSD
-    RealVec psdEstimateInput = {};
-    RealVec psdEstimateReference = {};
-    ComplexVec csdEstimate = {};
-    RealVec coherence = {};
-    RealVec smoothedCoherence = {};
-
-    // this is here for convenience, to be filled in in various places
-    ImColor uniqueCol = 0xFFFFFFFF;
-    std::string name = "";
-    bool active = true;
-    bool visible = true;
+    RealSpan psdEstimateInput = {};
+    RealSpan psdEstimateReference = {};
+    ComplexSpan csdEstimate = {};
+    RealSpan coherence = {};
+    RealSpan smoothedCoherence = {};
+
+    // this is here for convenience, filled in before the frame is published
     double fftDuration = 0.0;
     double sampleRate = 0.0;
+    /// counts up with every published frame, and is never reused. A recycled state gets a new one. 0 if never published
+    size_t serial = 0;
+
+    /// holds all the buffers above
+    Arena arena = {};
+
+private:
+    /**
+     * \brief Point the buffers into memory at base, each one aligned to Arena::alignment
+     * \param base start of the memory, nullptr to only count
+     * \return bytes needed for all buffers
+     */
+    size_t layout(std::byte* base) noexcept;
 };
 
-class State {
+/// finished frames are shared between processing and ui. Nobody writes to them while they are shared.
+using StateDataPtr = std::shared_ptr<const StateData>;
+
+class State : public std::enable_shared_from_this<State> {
 public:
     State() = delete;
     explicit State(size_t fftLen) noexcept;
@@ -94,16 +204,89 @@ public:
     State& operator=(const State&) noexcept = delete;
     State& operator=(State&&) noexcept = delete;
 
-    void calc(StateFilterConfig& filterConfig) noexcept;
+    /**
+     * \brief Everything that only depends on this frame: windows, ffts, transfer function, coherence, ir.
+     * \note Frames are independent here, so this can run for several states at once
+     * \param pool the independent parts of the frame are spread over this pool
+     */
+    void calcSpectrum(TaskPool& pool) noexcept;
+
+    /**
+     * \brief First part of calcSpectrum: windows, ffts, magnitude and transfer function
+     * \param pool the independent parts of the frame are spread over this pool
+     */
+    void calcFft(TaskPool& pool) noexcept;
+
+    /**
+     * \brief Second part of calcSpectrum: coherence and ir. Call after calcFft
+     * \note With SpectrumEstimator::CrossSpectrum, calcAverage does this instead
+     * \param pool the independent parts of the frame are spread over this pool
+     */
+    void calcSpectralProducts(TaskPool& pool) noexcept;
+
+    /**
+     * \brief Last part of calcSpectrum: smoothing of transfer function, ir and coherence. Call after calcSpectralProducts
+     * \note With SpectrumEstimator::CrossSpectrum, calcAverage does this instead
+     * \param pool the independent parts of the frame are spread over this pool
+     */
+    void calcSmoothing(TaskPool& pool) noexcept;
+
+    /**
+     * \brief Everything that depends on earlier frames: the magnitude averaging,
+     * and with SpectrumEstimator::CrossSpectrum, transfer function, coherence and ir.
+     * \note Call this after calcSpectrum, strictly in capture order and never for two states at once
+     * \param filterConfig filter config holding the averaging history. The averaging settings of this frame are applied to it first.
+     * \param pool the independent parts of the frame are spread over this pool
+     */
+    void calcAverage(StateFilterConfig& filterConfig, TaskPool& pool) noexcept;
+
+    /**
+     * \brief Set the settings this frame is processed with
+     * \note Call before calcSpectrum
+     * \param newSettings the settings
+     */
+    void setSettings(const StateFilterSettings& newSettings) noexcept;
 
     const StateData& getData() noexcept;
     StateData& accessData() noexcept;
 
+    /**
+     * \brief Rough number of bytes this state keeps allocated
+     * \return bytes
+     */
+    [[nodiscard]] size_t memoryUsage() const noexcept;
+
 private:
-    StateData data = {};
-    fftw_plan fftInputPlan = {};
-    fftw_plan fftReferencePlan = {};
-    fftw_plan impulseResponsePlan = {};
+    /// both ffts in one, for FftMode::PackedComplex
+    void calcPackedFft(TaskPool& pool) noexcept;
+    /// run the ir fft and normalize it
+    void calcImpulseResponse(TaskPool& pool) noexcept;
+    /// smooth transfer function, ir and coherence
+    void smoothResults(TaskPool& pool) noexcept;
+    /// the octave smoothing for settings.smoothingFraction
+    const OctaveSmoothing& octaveSmoothing() noexcept;
+
+    /// splitting bin loops smaller than this costs more than it brings
+    static constexpr size_t minBinsPerTask = 4096;
+    /// the sliding coherence sums are rebuilt from scratch every this many bins
+    static constexpr size_t coherenceRebuildInterval = 2048;
+
+    StateData data;
+    StateFilterSettings settings = {};
+    /// window for settings.windowFilter
+    std::shared_ptr<const WindowTable> window = nullptr;
+    /// smoothing for settings.smoothingFraction, once it was used
+    std::shared_ptr<const OctaveSmoothing> smoothing = nullptr;
+    /// shared with all states of the same length
+    std::shared_ptr<const FftPlan> forwardPlan = nullptr;
+    /// shared with all states of the same length
+    std::shared_ptr<const FftPlan> backwardPlan = nullptr;
+    /// for FftMode::PackedComplex. Made once the mode is used
+    std::shared_ptr<const FftPlan> packedPlan = nullptr;
+    /// input + i * reference, windowed, and then its fft. Only allocated once FftMode::PackedComplex is used
+    ComplexVec packed = {};
+    /// bytes allocated for packed. memoryUsage reads this from the ui thread while a worker might be allocating
+    std::atomic<size_t> packedBytes = { 0 };
 };
 
 #endif //laa_state_h
@@ -37,8 +37,14 @@ ImColor randColor()
 
 void StateManager::update(AudioHandler& audioHandler)
 {
-    if (audioHandler.getFrameCount() > lastFrame) {
-        liveState = audioHandler.getStateData();
+    // new frames are just a pointer swap. The old one goes back to the audio handler once nobody looks at it anymore
+    auto frameCount = audioHandler.getFrameCount();
+    if (frameCount != lastFrame) {
+        lastFrame = frameCount;
+        auto data = audioHandler.getStateData();
+        if (data != nullptr) {
+            liveState.data = std::move(data);
+        }
     }
 
     ImGui::Begin("Snapshot Control", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDecoration);
@@ -50,7 +56,9 @@ void StateManager::update(AudioHandler& audioHandler)
     size_t maxCaptures = 10;
 #endif
     if (saved.size() < maxCaptures && ImGui::Button("Capture")) {
+        // live data is recycled by the audio handler, so this one needs a copy of its own
         auto copy = liveState;
+        copy.data = std::make_shared<const StateData>(*liveState.data);
         copy.uniqueCol = randColor();
         copy.active = false;
         copy.visible = liveVisible;
@@ -100,12 +108,12 @@ void StateManager::update(AudioHandler& audioHandler)
     liveState.visible = liveVisible;
 }
 
-const StateData& StateManager::getLive() const noexcept
+const DisplayState& StateManager::getLive() const noexcept
 {
     return liveState;
 }
 
-const std::list<StateData>& StateManager::getSaved() const noexcept
+const std::list<DisplayState>& StateManager::getSaved() const noexcept
 {
     return saved;
 }
@@ -114,6 +122,7 @@ StateManager::StateManager() noexcept
 {
     liveState.name = "Live";
     liveState.active = true;
+    liveState.uniqueCol = ImGui::GetColorU32(ImGuiCol_Text);
 }
 
 void StateManager::deactivateAll()
@@ -23,24 +23,36 @@
 
 ImColor randColor();
 
+/**
+ * \brief A frame as the views see it: the data, and how to draw it
+ */
+struct DisplayState {
+    /// the frame. never null
+    StateDataPtr data = std::make_shared<const StateData>();
+    ImColor uniqueCol = 0xFFFFFFFF;
+    std::string name = "";
+    bool active = true;
+    bool visible = true;
+};
+
 class StateManager {
 public:
     StateManager() noexcept;
     ~StateManager() noexcept = default;
     void update(AudioHandler& audioHandler);
 
-    [[nodiscard]] const StateData& getLive() const noexcept;
+    [[nodiscard]] const DisplayState& getLive() const noexcept;
 
-    [[nodiscard]] const std::list<StateData>& getSaved() const noexcept;
+    [[nodiscard]] const std::list<DisplayState>& getSaved() const noexcept;
 
 private:
     void deactivateAll();
     size_t lastFrame = 0;
-    StateData liveState = {};
+    DisplayState liveState = {};
     bool liveVisible = true;
     bool liveActive = true;
 
-    std::list<StateData> saved = {};
+    std::list<DisplayState> saved = {};
 };
 
 #endif //laa_statemanager_h
@@ -0,0 +1,109 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The neighbour bin coherence slides its window sums along the spectrum. Here it is compared to summing up the
+// whole window for every bin, in double, the way it was done before.
+// The lengths cover a window that is clipped at dc and nyquist at once, one range of bins that goes through
+// several rebuilds of the sums, and a frame that is split over a pool with the widest window.
+
+#include "../src/state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <limits>
+#include <random>
+
+namespace {
+/**
+ * \brief Fill the spectra of state with noise, run calcSpectralProducts, and compare with the brute force sums
+ * \param fftLen length of the frame
+ * \param pool pool to run the frame on
+ * \return true if every bin is close enough
+ */
+bool check(size_t fftLen, TaskPool& pool) noexcept
+{
+    auto state = std::make_shared<State>(fftLen);
+    StateFilterSettings settings;
+    settings.spectrumEstimator = SpectrumEstimator::NeighbourBins;
+    state->setSettings(settings);
+
+    auto& data = state->accessData();
+    std::minstd_rand random(static_cast<unsigned>(fftLen));
+    std::normal_distribution<double> noise;
+    for (size_t i = 0; i < data.binCount; i++) {
+        data.fftReference.re[i] = static_cast<Real>(noise(random));
+        data.fftReference.im[i] = static_cast<Real>(noise(random));
+        // partly correlated, so the coherence is somewhere in between
+        data.fftInput.re[i] = static_cast<Real>(0.5 * data.fftReference.re[i] + noise(random));
+        data.fftInput.im[i] = static_cast<Real>(0.5 * data.fftReference.im[i] + noise(random));
+    }
+    state->calcSpectralProducts(pool);
+
+    // same as calcSpectralProducts
+    const size_t psdDepth = std::clamp(fftLen / 1024, static_cast<size_t>(64), static_cast<size_t>(512));
+    // the sliding sums drop and add up to the rebuild interval of bins between rebuilds
+    const double tolerance = 2048.0 * 8.0 * std::numeric_limits<Real>::epsilon();
+    for (size_t i = 0; i < data.binCount; i++) {
+        size_t start = i < psdDepth ? 0 : i - psdDepth;
+        size_t stop = std::min(data.binCount, i + psdDepth);
+        double psdReference = 0.0;
+        double psdInput = 0.0;
+        std::complex<double> csd = 0.0;
+        for (size_t j = start; j < stop; j++) {
+            std::complex<double> x(data.fftReference.re[j], data.fftReference.im[j]);
+            std::complex<double> y(data.fftInput.re[j], data.fftInput.im[j]);
+            psdReference += std::norm(x);
+            psdInput += std::norm(y);
+            csd += std::conj(x) * y;
+        }
+        double coherence = std::norm(csd) / (psdReference * psdInput);
+
+        // |csd| is at most sqrt(psdReference * psdInput), so that is what its error is relative to
+        const double csdScale = std::sqrt(psdReference * psdInput);
+        const std::complex<double> slidCsd(data.csdEstimate[i].real(), data.csdEstimate[i].imag());
+        if (std::abs(data.psdEstimateReference[i] - psdReference) > tolerance * psdReference
+            || std::abs(data.psdEstimateInput[i] - psdInput) > tolerance * psdInput
+            || std::abs(slidCsd - csd) > tolerance * csdScale
+            || std::abs(data.coherence[i] - coherence) > 4.0 * tolerance) {
+            std::printf("length %zu, %zu pool threads: bin %zu of %zu differs. coherence %f, expected %f\n", fftLen, pool.threadCount(), i,
+                data.binCount, static_cast<double>(data.coherence[i]), coherence);
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main()
+{
+    TaskPool serialPool;
+    TaskPool splitPool;
+    splitPool.start(2);
+
+    bool ok = true;
+    // 513 bins and a window of 128 around each, clipped at both ends
+    ok = check(LAA_MIN_FFT_LENGTH, serialPool) && ok;
+    // 4097 bins in one range, so the sums are rebuilt twice on the way
+    ok = check(8192, serialPool) && ok;
+    // the widest window, and ranges of bins that each start with a rebuild
+    ok = check(524288, splitPool) && ok;
+    ok = check(524288, serialPool) && ok;
+
+    return ok ? 0 : 1;
+}
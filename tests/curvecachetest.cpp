@@ -0,0 +1,85 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// A state that goes back to the pool and gets published again keeps its memory, so the views see the same addresses.
+// The curve cache has to notice the new frame anyway.
+
+#include "../src/curvecache.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace {
+/**
+ * \brief Publish state the way finishFrame does, with transfer function value in every bin
+ * \param state the state
+ * \param value transfer function value
+ * \param serial serial to publish with
+ * \return the frame as the ui sees it
+ */
+StateDataPtr publish(const std::shared_ptr<State>& state, Real value, size_t serial) noexcept
+{
+    auto& data = state->accessData();
+    for (auto& bin : data.transferFunction) {
+        bin = Complex(value, 0.0);
+    }
+    data.serial = serial;
+    return StateDataPtr(state, &state->getData());
+}
+
+/**
+ * \brief Check every value of a curve
+ * \param values the curve
+ * \param expected what every value should be
+ * \param what printed on failure
+ * \return true if all values match
+ */
+bool check(const RealVec& values, Real expected, const char* what) noexcept
+{
+    for (auto value : values) {
+        if (std::abs(value - expected) > static_cast<Real>(1e-6)) {
+            std::printf("%s: expected %f, got %f\n", what, static_cast<double>(expected), static_cast<double>(value));
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main()
+{
+    CurveCache curves;
+    auto state = std::make_shared<State>(LAA_MIN_FFT_LENGTH);
+    auto magnitude = kernels().magnitude;
+    bool ok = true;
+
+    auto frame = publish(state, 1.0, 1);
+    ok = check(curves.get(frame, frame->transferFunction, magnitude), 1.0, "first frame") && ok;
+
+    // the same frame again comes from the cache, even if the memory changed behind its back
+    state->accessData().transferFunction[0] = Complex(3.0, 0.0);
+    ok = check(curves.get(frame, frame->transferFunction, magnitude), 1.0, "cached frame") && ok;
+    curves.prune();
+
+    // the ui lets go, the state is recycled and published again
+    frame.reset();
+    frame = publish(state, 2.0, 2);
+    ok = check(curves.get(frame, frame->transferFunction, magnitude), 2.0, "recycled frame") && ok;
+    curves.prune();
+
+    return ok ? 0 : 1;
+}
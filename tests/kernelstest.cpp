@@ -0,0 +1,298 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Every kernel variant this cpu runs has to give the same results as the scalar kernels.
+// At startup a variant that does not is only skipped, here it fails the build.
+
+#include "../src/dsp/kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+/// covers every tail of every vector width, up to 16 floats in a zmm register, and then some
+constexpr size_t maxTailCount = 3 * 16 + 1;
+/// a long odd length, like the bins of a frame
+constexpr size_t longCount = 1031;
+
+template <class T>
+bool close(T value, T expected, T tolerance) noexcept
+{
+    return std::abs(value - expected) <= tolerance * std::max(T(1.0), std::abs(expected));
+}
+
+template <class T>
+bool closeComplex(std::complex<T> value, std::complex<T> expected, T tolerance) noexcept
+{
+    // the error of a quotient is relative to the whole quotient, not to its parts
+    return std::abs(value - expected) <= tolerance * std::max(T(1.0), std::abs(expected));
+}
+
+template <class T>
+const std::complex<T>* asComplex(const T* data) noexcept
+{
+    return reinterpret_cast<const std::complex<T>*>(data); // NOLINT
+}
+
+/**
+ * \brief One variant against the scalar kernels
+ * \tparam T float or double
+ */
+template <class T>
+class KernelCheck {
+public:
+    /**
+     * \brief Set up the check
+     * \param tested the variant
+     * \param precision printed on failure
+     */
+    KernelCheck(const SpectralKernelTable<T>& tested, const char* precision) noexcept
+        : kernels(tested)
+        , reference(scalarKernels<T>())
+        , precisionName(precision)
+    {
+        std::minstd_rand random(1234);
+        std::uniform_real_distribution<T> values(T(-10.0), T(10.0));
+        for (size_t i = 0; i < 2 * longCount; i++) {
+            a[i] = values(random);
+            b[i] = values(random);
+        }
+    }
+    /// deleted
+    KernelCheck(const KernelCheck&) = delete;
+    /// deleted
+    KernelCheck(KernelCheck&&) = delete;
+    /// deleted
+    KernelCheck& operator=(const KernelCheck&) = delete;
+    /// deleted
+    KernelCheck& operator=(KernelCheck&&) = delete;
+    /// dtor
+    ~KernelCheck() noexcept = default;
+
+    /**
+     * \brief Run every check
+     * \return true if the variant passed all of them
+     */
+    bool run() noexcept
+    {
+        for (size_t count = 0; count <= maxTailCount; count++) {
+            checkLength(count);
+        }
+        checkLength(longCount);
+        checkPhaseSpecials();
+        checkZeroDenominators();
+        return ok;
+    }
+
+private:
+    const SpectralKernelTable<T>& kernels;
+    const SpectralKernelTable<T>& reference;
+    const char* precisionName;
+    const T epsilon = std::numeric_limits<T>::epsilon();
+    std::vector<T> a = std::vector<T>(2 * longCount);
+    std::vector<T> b = std::vector<T>(2 * longCount);
+    std::vector<T> expected = std::vector<T>(2 * longCount);
+    std::vector<T> result = std::vector<T>(2 * longCount);
+    bool ok = true;
+
+    void fail(const char* kernel, size_t count, size_t index) noexcept
+    {
+        std::printf("%s %s %s, %zu elements: differs at %zu\n", kernels.name, precisionName, kernel, count, index);
+        ok = false;
+    }
+
+    /// compare the first n values of result and expected
+    void compare(const char* kernel, size_t count, size_t n, T tolerance) noexcept
+    {
+        for (size_t i = 0; i < n; i++) {
+            if (!close(result[i], expected[i], tolerance)) {
+                fail(kernel, count, i);
+                return;
+            }
+        }
+    }
+
+    /// compare the first n complex values of result and expected
+    void compareComplex(const char* kernel, size_t count, size_t n) noexcept
+    {
+        for (size_t i = 0; i < n; i++) {
+            if (!closeComplex(asComplex(result.data())[i], asComplex(expected.data())[i], 8 * epsilon)) {
+                fail(kernel, count, i);
+                return;
+            }
+        }
+    }
+
+    /// run every kernel on count elements. The output is poisoned first, and the element after count must stay untouched
+    void checkLength(size_t count) noexcept
+    {
+        const T poison = T(12345.0);
+        auto reset = [&]() {
+            std::fill(expected.begin(), expected.end(), poison);
+            std::fill(result.begin(), result.end(), poison);
+        };
+        auto untouched = [&](const char* kernel, size_t end) {
+            if (end < result.size() && std::memcmp(&result[end], &poison, sizeof(T)) != 0) {
+                fail(kernel, count, end);
+            }
+        };
+
+        reset();
+        std::copy(a.begin(), a.end(), expected.begin());
+        std::copy(a.begin(), a.end(), result.begin());
+        reference.scale(expected.data(), count, T(0.125));
+        kernels.scale(result.data(), count, T(0.125));
+        compare("scale", count, count, epsilon);
+
+        reset();
+        reference.multiply(expected.data(), a.data(), b.data(), count);
+        kernels.multiply(result.data(), a.data(), b.data(), count);
+        compare("multiply", count, count, epsilon);
+        untouched("multiply", count);
+
+        reset();
+        reference.magnitude(expected.data(), a.data(), count);
+        kernels.magnitude(result.data(), a.data(), count);
+        compare("magnitude", count, count, 4 * epsilon);
+        untouched("magnitude", count);
+
+        reset();
+        reference.magnitudeSplit(expected.data(), a.data(), b.data(), count);
+        kernels.magnitudeSplit(result.data(), a.data(), b.data(), count);
+        compare("magnitudeSplit", count, count, 4 * epsilon);
+        untouched("magnitudeSplit", count);
+
+        reset();
+        reference.magnitudeSquared(expected.data(), a.data(), count);
+        kernels.magnitudeSquared(result.data(), a.data(), count);
+        compare("magnitudeSquared", count, count, 4 * epsilon);
+        untouched("magnitudeSquared", count);
+
+        // the phase is an approximation, and absolute error is what counts for an angle
+        reset();
+        reference.phase(expected.data(), a.data(), count);
+        kernels.phase(result.data(), a.data(), count);
+        for (size_t i = 0; i < count; i++) {
+            if (std::abs(result[i] - expected[i]) > T(2e-6)) {
+                fail("phase", count, i);
+                break;
+            }
+        }
+        untouched("phase", count);
+
+        reset();
+        reference.divide(expected.data(), b.data(), a.data(), count);
+        kernels.divide(result.data(), b.data(), a.data(), count);
+        compareComplex("divide", count, count);
+        untouched("divide", 2 * count);
+
+        reset();
+        reference.divideSplit(expected.data(), b.data(), b.data() + longCount, a.data(), a.data() + longCount, count);
+        kernels.divideSplit(result.data(), b.data(), b.data() + longCount, a.data(), a.data() + longCount, count);
+        compareComplex("divideSplit", count, count);
+        untouched("divideSplit", 2 * count);
+    }
+
+    /// zeros and both axes, with both signs of zero. arg(-0 + 0i) is pi, the kernels give 0 there on purpose
+    void checkPhaseSpecials() noexcept
+    {
+        const std::complex<T> specials[] = { { T(0.0), T(0.0) }, { T(0.0), T(-0.0) }, { T(0.0), T(1.0) }, { T(0.0), T(-1.0) }, // NOLINT
+            { T(-0.0), T(1.0) }, { T(-0.0), T(-1.0) }, { T(1.0), T(0.0) }, { T(1.0), T(-0.0) }, { T(-1.0), T(0.0) },
+            { T(-1.0), T(-0.0) }, { T(1.0), T(1.0) }, { T(-1.0), T(-1.0) }, { T(1e-30), T(0.0) }, { T(0.0), T(1e-30) } };
+        constexpr size_t count = sizeof(specials) / sizeof(specials[0]);
+        std::vector<T> in(2 * count);
+        for (size_t i = 0; i < count; i++) {
+            in[2 * i] = specials[i].real();
+            in[2 * i + 1] = specials[i].imag();
+        }
+
+        kernels.phase(result.data(), in.data(), count);
+        for (size_t i = 0; i < count; i++) {
+            if (std::abs(result[i] - std::arg(specials[i])) > T(2e-6)) {
+                fail("phase of a special value", count, i);
+            }
+        }
+    }
+
+    /// zero denominators give inf or nan, and do not spill over into the other bins of their vector
+    void checkZeroDenominators() noexcept
+    {
+        std::vector<T> den(a);
+        std::vector<T> denRe(a.begin(), a.begin() + longCount);
+        std::vector<T> denIm(a.begin() + longCount, a.end());
+        auto isZero = [](size_t i) { return i % 7 == 0 || i % 16 == 5; };
+        for (size_t i = 0; i < longCount; i++) {
+            if (isZero(i)) {
+                den[2 * i] = T(0.0);
+                den[2 * i + 1] = T(0.0);
+                denRe[i] = T(0.0);
+                denIm[i] = T(0.0);
+            }
+        }
+
+        auto check = [&](const char* kernel) {
+            for (size_t i = 0; i < longCount; i++) {
+                auto value = asComplex(result.data())[i];
+                if (isZero(i) ? std::isfinite(value.real()) && std::isfinite(value.imag())
+                              : !closeComplex(value, asComplex(expected.data())[i], 8 * epsilon)) {
+                    fail(kernel, longCount, i);
+                    return;
+                }
+            }
+        };
+
+        reference.divide(expected.data(), b.data(), den.data(), longCount);
+        kernels.divide(result.data(), b.data(), den.data(), longCount);
+        check("divide by zero");
+
+        reference.divideSplit(expected.data(), b.data(), b.data() + longCount, denRe.data(), denIm.data(), longCount);
+        kernels.divideSplit(result.data(), b.data(), b.data() + longCount, denRe.data(), denIm.data(), longCount);
+        check("divideSplit by zero");
+    }
+};
+
+/**
+ * \brief Check all variants of one precision
+ * \return true if all passed
+ */
+template <class T>
+bool checkAll(const char* precision) noexcept
+{
+    const SpectralKernelTable<T>* tables[maxKernelVariants] = {}; // NOLINT
+    size_t count = runnableKernels(tables);
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        KernelCheck<T> check(*tables[i], precision); // NOLINT
+        ok = check.run() && ok;
+        std::printf("%s %s checked\n", tables[i]->name, precision); // NOLINT
+    }
+    return ok;
+}
+}
+
+int main()
+{
+    bool ok = checkAll<double>("double");
+    ok = checkAll<float>("float") && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The packed complex fft has to give the same frame as two real ffts: the same spectra, and the same windowed signals.
+
+#include "../src/state.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+
+namespace {
+/**
+ * \brief Run one frame of noise through both fft modes and compare them
+ * \param fftLen length of the frame
+ * \param pool pool to run the frames on
+ * \return true if both frames match
+ */
+bool check(size_t fftLen, TaskPool& pool) noexcept
+{
+    auto separate = std::make_shared<State>(fftLen);
+    auto packed = std::make_shared<State>(fftLen);
+    StateFilterSettings settings;
+    separate->setSettings(settings);
+    settings.fftMode = FftMode::PackedComplex;
+    packed->setSettings(settings);
+
+    std::minstd_rand random(static_cast<unsigned>(fftLen));
+    std::normal_distribution<double> noise;
+    for (size_t i = 0; i < fftLen; i++) {
+        auto in = static_cast<Real>(noise(random));
+        auto ref = static_cast<Real>(noise(random));
+        separate->accessData().input[i] = in;
+        packed->accessData().input[i] = in;
+        separate->accessData().reference[i] = ref;
+        packed->accessData().reference[i] = ref;
+    }
+    separate->calcFft(pool);
+    packed->calcFft(pool);
+
+    const auto& a = separate->getData();
+    const auto& b = packed->getData();
+    for (size_t i = 0; i < fftLen; i++) {
+        // the same multiplication in both modes
+        if (std::abs(a.windowedInput[i] - b.windowedInput[i]) > 0 || std::abs(a.windowedReference[i] - b.windowedReference[i]) > 0) {
+            std::printf("length %zu: windowed sample %zu differs\n", fftLen, i);
+            return false;
+        }
+    }
+    // errors of an fft grow with the log of its length, and are relative to the energy of the whole signal
+    const double tolerance = 64.0 * std::log2(static_cast<double>(fftLen)) * std::numeric_limits<Real>::epsilon() * std::sqrt(static_cast<double>(fftLen));
+    for (size_t i = 0; i < a.binCount; i++) {
+        if (std::abs(a.fftInput.re[i] - b.fftInput.re[i]) > tolerance || std::abs(a.fftInput.im[i] - b.fftInput.im[i]) > tolerance
+            || std::abs(a.fftReference.re[i] - b.fftReference.re[i]) > tolerance
+            || std::abs(a.fftReference.im[i] - b.fftReference.im[i]) > tolerance) {
+            std::printf("length %zu: bin %zu differs\n", fftLen, i);
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main()
+{
+    TaskPool serialPool;
+    TaskPool splitPool;
+    splitPool.start(2);
+
+    bool ok = check(LAA_MIN_FFT_LENGTH, serialPool);
+    ok = check(16384, splitPool) && ok;
+    return ok ? 0 : 1;
+}
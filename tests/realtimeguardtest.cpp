@@ -0,0 +1,81 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The hooks of the realtime guard have to see what happens on a realtime thread, and nothing that happens elsewhere.
+
+#include "../src/audio/realtimeguard.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+
+namespace {
+/**
+ * \brief Check the violation count
+ * \param expected what it should be
+ * \param what printed on failure
+ * \return true if it matches
+ */
+bool check(size_t expected, const char* what) noexcept
+{
+    auto violations = getRealtimeViolations();
+    if (violations != expected) {
+        std::printf("%s: expected %zu violations, got %zu\n", what, expected, violations);
+        return false;
+    }
+    return true;
+}
+
+/// keeps the compiler from optimizing allocations away
+void* volatile sink = nullptr;
+}
+
+int main()
+{
+    static_assert(realtimeGuardEnabled(), "this test needs LAA_RT_GUARD");
+    bool ok = true;
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    // outside of a scope, nothing counts
+    sink = std::malloc(16);
+    std::free(sink);
+    pthread_mutex_lock(&mutex);
+    pthread_mutex_unlock(&mutex);
+    ok = check(0, "outside") && ok;
+
+    {
+        RealtimeScope realtime;
+        sink = std::malloc(16);
+        ok = check(1, "malloc") && ok;
+        std::free(sink);
+        ok = check(2, "free") && ok;
+        pthread_mutex_lock(&mutex);
+        ok = check(3, "pthread_mutex_lock") && ok;
+        pthread_mutex_unlock(&mutex);
+        sink = new int(1);
+        ok = check(4, "operator new") && ok;
+        delete static_cast<int*>(sink);
+        ok = check(5, "operator delete") && ok;
+    }
+
+    // and the scope is gone again
+    sink = std::malloc(16);
+    std::free(sink);
+    ok = check(5, "after") && ok;
+
+    return ok ? 0 : 1;
+}
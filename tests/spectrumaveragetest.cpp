@@ -0,0 +1,114 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Frame averaging keeps a running sum over a history it does not own. Here it is compared to the plain mean of
+// the last frames, across several trips around the history, so the sum is rebuilt on the way.
+
+#include "../src/dsp/spectrumaverage.h"
+#include "../src/state.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr size_t binCount = 513;
+constexpr size_t frameCount = 7;
+/// a bit more than three trips around the history
+constexpr size_t addCount = 3 * frameCount + 4;
+
+/**
+ * \brief Add noise frames and compare every average with the mean of the last frameCount frames
+ * \param pool pool to average on
+ * \return true if every average matched
+ */
+bool checkMean(TaskPool& pool) noexcept
+{
+    SpectrumAverage average;
+    auto history = std::make_shared<SpectrumHistory>(binCount, frameCount);
+    if (!average.configure(binCount, SpectrumAveraging::Frames, frameCount, history)) {
+        std::printf("a matching history was refused\n");
+        return false;
+    }
+
+    std::minstd_rand random(42);
+    std::uniform_real_distribution<double> noise(0.0, 1000.0);
+    std::vector<RealVec> frames;
+    RealVec result(binCount);
+    for (size_t frame = 0; frame < addCount; frame++) {
+        frames.emplace_back(binCount);
+        for (auto& value : frames.back()) {
+            value = static_cast<Real>(noise(random));
+        }
+        result = frames.back();
+        average.add(result, pool);
+
+        size_t first = frame + 1 > frameCount ? frame + 1 - frameCount : 0;
+        for (size_t i = 0; i < binCount; i++) {
+            double mean = 0.0;
+            for (size_t j = first; j <= frame; j++) {
+                mean += static_cast<double>(frames[j][i]);
+            }
+            mean /= static_cast<double>(frame + 1 - first);
+            if (std::abs(result[i] - mean) > 16.0 * std::numeric_limits<Real>::epsilon() * mean) {
+                std::printf("frame %zu, bin %zu: %f, expected %f\n", frame, i, static_cast<double>(result[i]), mean);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief The history of the longest frame stays within its cap, and a history of the wrong size is refused
+ * \return true if both hold
+ */
+bool checkLimits() noexcept
+{
+    bool ok = true;
+    const size_t longBins = LAA_MAX_FFT_LENGTH / 2 + 1;
+    size_t frames = StateFilterConfig::historyFrames(LAA_MAX_FFT_AVG, longBins);
+    if (frames == 0 || frames * longBins * sizeof(Real) > SpectrumHistory::maxBytes) {
+        std::printf("%zu frames of %zu bins do not fit\n", frames, longBins);
+        ok = false;
+    }
+    if (StateFilterConfig::historyFrames(LAA_MAX_FFT_AVG, LAA_MIN_FFT_LENGTH / 2 + 1) != LAA_MAX_FFT_AVG) {
+        std::printf("short frames got capped\n");
+        ok = false;
+    }
+
+    SpectrumAverage average;
+    auto history = std::make_shared<SpectrumHistory>(binCount, frameCount);
+    if (average.configure(binCount + 1, SpectrumAveraging::Frames, frameCount, history)
+        || average.configure(binCount, SpectrumAveraging::Frames, frameCount + 1, history)
+        || average.configure(binCount, SpectrumAveraging::Frames, frameCount, nullptr)) {
+        std::printf("a history that does not fit was taken\n");
+        ok = false;
+    }
+    return ok;
+}
+}
+
+int main()
+{
+    TaskPool serialPool;
+    bool ok = checkMean(serialPool);
+    ok = checkLimits() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/*
+ * This file is part of LAA
+ * Copyright (c) 2020 Malte Kießling
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Runs the capture side of the audio callback against a worker that is too slow to keep up.
+// The capture runs under the realtime guard, so any lock or allocation on its side fails the test.
+// Every frame that is not dropped has to arrive exactly once and in order, and no state may get lost on the way.
+
+#include "../src/audio/lightweightsemaphore.h"
+#include "../src/audio/realtimeguard.h"
+#include "../src/audio/spscring.h"
+#include "../src/state.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+/// same as AudioHandler::StateRing
+using StateRing = SpscRing<State*, 64>;
+/// same as AudioHandler::defaultPoolSize
+constexpr size_t poolSize = 5;
+/// buffers the capture runs for
+constexpr size_t bufferCount = 20000;
+/// the capture cuts a frame every this
+constexpr auto hopTime = std::chrono::microseconds(50);
+/// the worker needs this long per frame, so the pool runs dry over and over
+constexpr auto frameTime = std::chrono::microseconds(200);
+
+/**
+ * \brief What the capture did
+ */
+struct CaptureResult {
+    size_t captured = 0;
+    size_t dropped = 0;
+};
+
+/**
+ * \brief The part of AudioHandler::audioCallback that cuts frames, once per hop
+ * \param unusedStates states the capture can fill
+ * \param processStates filled states for the worker
+ * \param wakeup posted for every filled state
+ * \param result counts
+ */
+void capture(StateRing& unusedStates, StateRing& processStates, LightweightSemaphore& wakeup, CaptureResult& result) noexcept
+{
+    RealtimeScope realtime;
+    for (size_t i = 0; i < bufferCount; i++) {
+        State* state = nullptr;
+        if (unusedStates.pop(state)) {
+            // the frame number instead of samples, so the worker can tell what it got
+            auto& data = state->accessData();
+            std::fill(data.input.begin(), data.input.end(), static_cast<Real>(result.captured));
+            processStates.push(state);
+            wakeup.post();
+            ++result.captured;
+        } else {
+            ++result.dropped;
+        }
+        std::this_thread::sleep_for(hopTime);
+    }
+}
+}
+
+int main()
+{
+    std::vector<std::shared_ptr<State>> pool;
+    StateRing unusedStates;
+    StateRing processStates;
+    LightweightSemaphore wakeup;
+    for (size_t i = 0; i < poolSize; i++) {
+        pool.push_back(std::make_shared<State>(LAA_MIN_FFT_LENGTH));
+        unusedStates.push(pool.back().get());
+    }
+
+    CaptureResult result;
+    std::atomic<bool> captureDone = { false };
+    std::thread captureThread([&]() {
+        capture(unusedStates, processStates, wakeup, result);
+        captureDone = true;
+        wakeup.post();
+    });
+
+    // the worker. checks each frame, takes its time, and hands the state back
+    bool ok = true;
+    size_t processed = 0;
+    while (true) {
+        wakeup.wait();
+        State* state = nullptr;
+        if (!processStates.pop(state)) {
+            if (captureDone) {
+                break;
+            }
+            continue;
+        }
+
+        const auto& data = state->getData();
+        auto first = static_cast<size_t>(data.input[0]);
+        auto last = static_cast<size_t>(data.input[data.input.size() - 1]);
+        if (first != processed || last != processed) {
+            std::printf("frame %zu arrived as %zu..%zu\n", processed, first, last);
+            ok = false;
+        }
+        ++processed;
+        std::this_thread::sleep_for(frameTime);
+        unusedStates.push(state);
+    }
+    captureThread.join();
+
+    if (processed != result.captured) {
+        std::printf("captured %zu frames, but %zu arrived\n", result.captured, processed);
+        ok = false;
+    }
+    if (result.dropped == 0) {
+        std::printf("the worker was never too slow, the test did not test anything\n");
+        ok = false;
+    }
+
+    // every state is back where it started, exactly once
+    std::set<State*> returned;
+    State* state = nullptr;
+    size_t returnedCount = 0;
+    while (unusedStates.pop(state)) {
+        returned.insert(state);
+        ++returnedCount;
+    }
+    if (returnedCount != poolSize || returned.size() != poolSize || !processStates.empty()) {
+        std::printf("%zu states came back, %zu of them different, %zu still queued\n", returnedCount, returned.size(), processStates.size());
+        ok = false;
+    }
+    for (const auto& pooled : pool) {
+        if (returned.count(pooled.get()) != 1) {
+            std::printf("a state got lost\n");
+            ok = false;
+        }
+    }
+
+    if (getRealtimeViolations() != 0) {
+        std::printf("the capture locked or allocated %zu times\n", getRealtimeViolations());
+        ok = false;
+    }
+
+    std::printf("%zu frames, %zu dropped, realtime guard %s\n", processed, result.dropped, realtimeGuardEnabled() ? "on" : "off");
+    return ok ? 0 : 1;
+}